@@ -17,6 +17,8 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "file.h"
+#include "pollq.h"
+#include "poll.h"
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
@@ -50,6 +52,8 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+
+  struct pollq pollq;  // poll()s waiting for a line
 } cons;
 
 //
@@ -170,6 +174,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        pollwake(&cons.pollq);
       }
     }
     break;
@@ -178,10 +183,26 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+// poll() on the console: a line is ready to read,
+// and writes never wait.
+int
+consolepoll(struct pollq **qp)
+{
+  int r = POLLOUT;
+
+  acquire(&cons.lock);
+  if(cons.r != cons.w)
+    r |= POLLIN;
+  release(&cons.lock);
+  *qp = &cons.pollq;
+  return r;
+}
+
 void
 consoleinit(void)
 {
   initlock(&cons.lock, "cons");
+  pollqinit(&cons.pollq);
 
   uartinit();
 
@@ -189,4 +210,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
@@ -1,13 +1,16 @@
 struct buf;
 struct context;
+struct cpu;
 struct file;
 struct inode;
 struct pipe;
+struct pollq;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct timer;
 
 // bio.c
 void            binit(void);
@@ -26,12 +29,15 @@ void            consputc(int);
 int             exec(char*, char**);
 
 // file.c
+struct file*    fdget(int);
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
+int             filepoll(struct file*, struct pollq**);
 int             filestat(struct file*, uint64 addr);
+int             filelseek(struct file*, int, int);
 int             filewrite(struct file*, uint64, int n);
 
 // fs.c
@@ -59,6 +65,15 @@ void            ramdiskinit(void);
 void            ramdiskintr(void);
 void            ramdiskrw(struct buf*);
 
+// futex.c
+void            futexinit(void);
+int             futex(uint64, int, int);
+
+// ipi.c
+void            ipisend(struct cpu*, int);
+int             ipiintr(void);
+void            tlbshootdown(pagetable_t);
+
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
@@ -71,10 +86,52 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
-int             pipealloc(struct file**, struct file**);
+int             pipealloc(struct file**, struct file**, int);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
+int             pipepoll(struct pipe*, int, struct pollq**);
+
+// poll.c
+void            pollinit(void);
+void            pollqinit(struct pollq*);
+void            pollwake(struct pollq*);
+int             poll(uint64, int, uint64);
+
+// ring.c
+uint64          ringsetup(int);
+void            ringfree(struct proc*);
+int             ringenter(int);
+void            ringpoll(void);
+
+// perf.c
+void            perfinit(void);
+void            perfinithart(void);
+void            perfsync(void);
+void            perfstamp(struct proc*);
+void            perfcharge(struct proc*);
+int             perfctl(int, uint64);
+int             perfread(uint64);
+
+// sysstat.c
+void            statsyscall(int, uint64);
+void            statirq(int, uint64);
+void            stattick(void);
+void            statidle(uint64);
+int             sysstat(uint64);
+
+// trace.c
+extern int      tracemask;
+void            traceinit(void);
+void            trace(int, uint64, int);
+int             tracectl(int);
+int             traceread(uint64, int);
+
+// prof.c
+void            profinit(void);
+void            profarm(void);
+int             profctl(int);
+int             profread(uint64, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -85,7 +142,8 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+uint64          growproc(int);
+int             clone(uint64, uint64, uint64);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
@@ -102,10 +160,15 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+int             wakeupn(void*, int);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             procstat(uint64, int);
+int             needresched(struct proc*);
+int             setsched(int, int, int);
+uint64          setaffinity(int, uint64);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -117,6 +180,7 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstat(uint64, int);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -142,12 +206,25 @@ int             fetchaddr(uint64, uint64*);
 void            syscall();
 
 // trap.c
-extern uint     ticks;
-void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
 void            usertrapret(void);
 
+// start.c
+extern int      sstc[];
+
+// timer.c
+extern char     timepage[];
+void            clockinit(void);
+void            clockinithart(void);
+void            timer_add(struct timer*);
+int             timer_del(struct timer*);
+int             timerintr(void);
+void            tickstop(void);
+void            tickstart(void);
+uint64          uptime(void);
+uint64          nanotime(void);
+int             nanosleep(uint64);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -170,6 +247,7 @@ void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
+uint64          uvmresident(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
@@ -179,6 +257,8 @@ void            plicinit(void);
 void            plicinithart(void);
 int             plic_claim(void);
 void            plic_complete(int);
+uint64          irqaffinity(int, uint64);
+int             irqstat(int, uint64);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
@@ -186,13 +266,23 @@ void            virtio_disk_rw(struct buf *, int);
 void            virtio_disk_intr(void);
 
 // virtiogpu.c
+void            init_virtiogpu_locks(void);
 void            init_virtiogpu(void);
 void            virtiogpu_isr(void); // interrupt service routine for virtio1
+int             gpupoll(struct pollq**);
+
+// sysgpu.c
+uint64          gpucmd(int);
+
+// syskbd.c
+uint64          kbdcmd(void);
 #define         FRAMEBUFFER_WIDTH 320
 #define         FRAMEBUFFER_HEIGHT 200
 // virtiokbd.c
+void            init_virtiokbd_locks(void);
 void            init_virtiokbd(void);
 void            virtiokbd_isr(void); // interrupt service routine for virtio2
+int             kbdpoll(struct pollq**);
 
 void		init_virtiosnd(void);
 void		virtiosnd_isr(void);
@@ -31,6 +31,11 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // the group's other threads would be left running
+  // in the old image.
+  if(p->tg != p || p->threadslots != 0)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -121,6 +126,7 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  ringfree(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
@@ -12,6 +12,8 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "poll.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -43,6 +45,24 @@ filealloc(void)
   return 0;
 }
 
+// Return the calling thread group's file for fd, with a
+// reference held, or 0. The caller must fileclose() it; until
+// then a sibling thread's close() cannot free it.
+struct file*
+fdget(int fd)
+{
+  struct proc *p = myproc()->tg;
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->lock);
+  if((f = p->ofile[fd]) != 0)
+    filedup(f);
+  release(&p->lock);
+  return f;
+}
+
 // Increment ref count for file f.
 struct file*
 filedup(struct file *f)
@@ -101,6 +121,55 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Move file f's offset, as lseek() does; whence is
+// SEEK_SET, SEEK_CUR or SEEK_END. The offset may not
+// go past the end of the file, since writei() can't
+// leave a hole.
+int
+filelseek(struct file *f, int off, int whence)
+{
+  int r;
+
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  if(whence == SEEK_CUR)
+    off += f->off;
+  else if(whence == SEEK_END)
+    off += f->ip->size;
+  else if(whence != SEEK_SET)
+    off = -1;
+  if(off < 0 || off > f->ip->size){
+    r = -1;
+  } else {
+    f->off = off;
+    r = off;
+  }
+  iunlock(f->ip);
+  return r;
+}
+
+// Which of POLLIN, POLLOUT and POLLHUP hold for f now,
+// and in *qp the pollq to wait on for that to change, if any.
+int
+filepoll(struct file *f, struct pollq **qp)
+{
+  int r;
+
+  *qp = 0;
+  if(f->type == FD_PIPE)
+    return pipepoll(f->pipe, f->writable, qp);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].poll)
+    r = devsw[f->major].poll(qp);
+  else
+    r = POLLIN | POLLOUT;  // inodes never make us wait
+  if(!f->readable)
+    r &= ~POLLIN;
+  if(!f->writable)
+    r &= ~POLLOUT;
+  return r;
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -30,9 +30,11 @@ struct inode {
 };
 
 // map major device number to device functions.
+struct pollq;
 struct devsw {
   int (*read)(int, uint64, int);
   int (*write)(int, uint64, int);
+  int (*poll)(struct pollq**);   // POLLIN/POLLOUT ready; 0 means always both
 };
 
 extern struct devsw devsw[];
@@ -0,0 +1,66 @@
+//
+// Fast user-space mutexes.
+//
+// Threads sharing memory lock and unlock with atomic
+// instructions, and only enter the kernel to sleep when
+// a lock is contended, or to wake its sleepers. A futex
+// is named by the physical address of its int, which is
+// the sleep channel for it.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "futex.h"
+#include "defs.h"
+
+// serializes the check of *addr against each wakeup.
+struct spinlock futexlock;
+
+void
+futexinit(void)
+{
+  initlock(&futexlock, "futex");
+}
+
+// FUTEX_WAIT: sleep on addr, unless the int there no longer
+// holds val. Returns 0 once woken, or -1 at once.
+// FUTEX_WAKE: wake at most val threads sleeping on addr,
+// and return how many there were.
+int
+futex(uint64 addr, int op, int val)
+{
+  struct proc *p = myproc();
+  uint64 pa;
+  int n;
+
+  if(addr % sizeof(int) != 0 || addr >= p->tg->sz)
+    return -1;
+  if((pa = walkaddr(p->pagetable, addr)) == 0)
+    return -1;
+  pa += addr % PGSIZE;
+
+  acquire(&futexlock);
+  switch(op){
+  case FUTEX_WAIT:
+    // whoever changed *addr before waking us must
+    // take futexlock to do it, so can't slip in here.
+    if(*(volatile int*)pa != val || killed(p)){
+      n = -1;
+      break;
+    }
+    sleep((void*)pa, &futexlock);
+    n = 0;
+    break;
+  case FUTEX_WAKE:
+    n = wakeupn((void*)pa, val);
+    break;
+  default:
+    n = -1;
+  }
+  release(&futexlock);
+  return n;
+}
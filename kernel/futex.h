@@ -0,0 +1,3 @@
+// Operations for futex().
+#define FUTEX_WAIT 0  // sleep, if the int at addr still holds val
+#define FUTEX_WAKE 1  // wake at most val sleepers on addr
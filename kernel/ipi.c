@@ -0,0 +1,80 @@
+//
+// Inter-processor interrupts.
+//
+// A hart interrupts another by writing the target's CLINT MSIP
+// register. That raises a machine-mode software interrupt, which
+// timervec in kernelvec.S forwards as a supervisor software
+// interrupt, just like a timer interrupt. The reason for the
+// interrupt is in the target's cpu->ipipending bits.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+// Interrupt hart c for the reasons in the IPI_* bits of what.
+void
+ipisend(struct cpu *c, int what)
+{
+  __sync_fetch_and_or(&c->ipipending, what);
+  __sync_synchronize();
+  *(uint32*)CLINT_MSIP(c - cpus) = 1;
+}
+
+// Called by devintr() on a supervisor software interrupt.
+// Handles whatever other harts asked for.
+// Returns 1 if this cpu was asked to reschedule.
+int
+ipiintr(void)
+{
+  struct cpu *c = mycpu();
+  int what;
+
+  what = __sync_lock_test_and_set(&c->ipipending, 0);
+  __sync_synchronize();
+  if(what & IPI_TLB){
+    sfence_vma();
+    __sync_fetch_and_add(&c->tlbacks, 1);
+  }
+  if(what & IPI_PROF)
+    profarm();
+  if(what & IPI_PERF)
+    perfsync();
+  return (what & IPI_RESCHED) != 0;
+}
+
+// Flush stale user mappings of pagetable from the TLBs of other
+// harts that are running a process with that page table, and wait
+// until they have. Call after removing mappings. Interrupts must
+// be on, so that a hart shooting at this one is not kept waiting.
+void
+tlbshootdown(pagetable_t pagetable)
+{
+  struct cpu *c, *me;
+  struct proc *p;
+  int acks[NCPU];
+  uint64 mask = 0;
+
+  push_off();
+  me = mycpu();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    p = c->proc;
+    if(c == me || !c->online || p == 0 || p->pagetable != pagetable)
+      continue;
+    acks[c - cpus] = c->tlbacks;
+    mask |= 1L << (c - cpus);
+    ipisend(c, IPI_TLB);
+  }
+  pop_off();
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(mask & (1L << (c - cpus))){
+      while(*(volatile int*)&c->tlbacks == acks[c - cpus])
+        ;
+    }
+  }
+}
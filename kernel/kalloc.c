@@ -30,13 +30,23 @@ kinit()
   freerange(end, (void*)PHYSTOP);
 }
 
+// Free the pages from pa_start to pa_end. Nothing has used them,
+// so there are no dangling references for kfree()'s junk to catch,
+// and filling all of memory with it is the slowest part of boot.
 void
 freerange(void *pa_start, void *pa_end)
 {
+  struct run *r;
   char *p;
+
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  acquire(&kmem.lock);
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    r = (struct run*)p;
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+  }
+  release(&kmem.lock);
 }
 
 // Free the page of physical memory pointed at by pa,
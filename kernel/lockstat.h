@@ -0,0 +1,9 @@
+// Lock contention statistics, kept per lock name when the
+// kernel is built with LOCKSTAT (make LOCKSTAT=1); see
+// spinlock.c and lockstat().
+struct lockstat {
+  char name[16];     // Lock name, as given to initlock().
+  uint64 nacquire;   // Times acquired.
+  uint64 ncontended; // Times acquire() had to wait.
+  uint64 spincycles; // Cycles spent waiting.
+};
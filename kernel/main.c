@@ -6,6 +6,82 @@
 
 volatile static int started = 0;
 
+// Boot stages, timed with mtime, which counts from machine reset.
+// bootreport() prints them once the device probes are done.
+#define NBOOTSTAGE 32
+static struct {
+  char *name;
+  int hart;
+  uint64 start, end;
+} stages[NBOOTSTAGE];
+static int nstage;
+static uint64 stagestart[NCPU];  // where each hart's current stage began
+
+// Device probes, which wait on device round trips and which
+// nothing at boot depends on. The first process doesn't wait for
+// them: each hart, hart 0 too, takes the next one nobody has
+// taken before it enters the scheduler. System calls that need a
+// device wait until its probe is done.
+static struct {
+  char *name;
+  void (*init)(void);
+} probes[] = {
+  { "virtiogpu", init_virtiogpu },
+  { "virtiokbd", init_virtiokbd },
+  { "virtiosnd", init_virtiosnd },
+};
+static int nextprobe, probesdone;
+
+// the stage that just finished on this hart.
+static void
+bootstage(char *name)
+{
+  int id = cpuid();
+  int i = __sync_fetch_and_add(&nstage, 1);
+  uint64 now = r_time();
+
+  if(i < NBOOTSTAGE){
+    stages[i].hart = id;
+    stages[i].start = stagestart[id];
+    stages[i].end = now;
+    __sync_synchronize();
+    stages[i].name = name;
+  }
+  stagestart[id] = now;
+}
+
+static void
+bootreport(void)
+{
+  int i;
+
+  printf("boot stage\thart\tstart us\ttook us\n");
+  for(i = 0; i < nstage && i < NBOOTSTAGE; i++){
+    if(stages[i].name == 0)
+      continue;
+    printf("%s\t%s%d\t%d\t\t%d\n", stages[i].name,
+           strlen(stages[i].name) < 8 ? "\t" : "", stages[i].hart,
+           (int)(stages[i].start / (MTIME_FREQ / 1000000)),
+           (int)((stages[i].end - stages[i].start) / (MTIME_FREQ / 1000000)));
+  }
+}
+
+// run device probes until none are left. the last one to finish
+// prints the boot report.
+static void
+runprobes(void)
+{
+  int i;
+
+  while((i = __sync_fetch_and_add(&nextprobe, 1)) < NELEM(probes)){
+    stagestart[cpuid()] = r_time();
+    probes[i].init();
+    bootstage(probes[i].name);
+    if(__sync_add_and_fetch(&probesdone, 1) == NELEM(probes))
+      bootreport();
+  }
+}
+
 // start() jumps here in supervisor mode on all CPUs.
 void
 main()
@@ -16,33 +92,50 @@ main()
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
+    bootstage("console");
     kinit();         // physical page allocator
+    bootstage("kinit");
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    bootstage("kvminit");
     procinit();      // process table
-    trapinit();      // trap vectors
+    futexinit();     // futex sleep lock
+    pollinit();      // poll() sleep lock
+    profinit();      // profiler sample buffers
+    perfinit();      // performance counter events
+    traceinit();     // event trace rings
     trapinithart();  // install kernel trap vector
+    clockinit();     // per-cpu timer queues
+    clockinithart(); // start this cpu's clock tick
+    perfinithart();  // performance counters for user space
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
+    bootstage("tables");
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
     virtio_disk_init(); // emulated hard disk
-    init_virtiogpu(); // virtiogpu init
-    init_virtiokbd(); // virtiokbd init
-    init_virtiosnd();     // sound init	
+    init_virtiogpu_locks(); // gpu and keyboard locks, for
+    init_virtiokbd_locks(); // system calls before runprobes()
+    bootstage("fs");
     userinit();      // first user process
+    bootstage("userinit");
     __sync_synchronize();
     started = 1;
   } else {
     while(started == 0)
       ;
     __sync_synchronize();
+    stagestart[cpuid()] = r_time();
     printf("hart %d starting\n", cpuid());
     kvminithart();    // turn on paging
     trapinithart();   // install kernel trap vector
+    clockinithart();  // start this cpu's clock tick
+    perfinithart();   // performance counters for user space
     plicinithart();   // ask PLIC for device interrupts
+    bootstage("hart");
   }
+  runprobes();        // virtiogpu, virtiokbd and virtiosnd
   // LW: Until scheduler() we do not get interrupts...
   scheduler();        
 }
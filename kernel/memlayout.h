@@ -40,8 +40,10 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // software interrupt pending.
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIME_FREQ 10000000L // mtime cycles per second on qemu's virt machine.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -75,9 +77,15 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   RINGPAGE (system call rings, if ringsetup() was called)
+//   THREADFRAME(i) (p->trapframe of each thread sharing this page table)
+//   TIMEPAGE (read-only struct timepage, for reading the clock without a trap)
 //   FRAMEBUFFER (where the framebuffer will go in user address space when PTEs modified)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
 // 64 pages = 262144 bytes, just over 320x200x4 = 256000
 #define FRAMEBUFFER (TRAPFRAME - PGSIZE * 64)
+#define TIMEPAGE (FRAMEBUFFER - PGSIZE)
+#define THREADFRAME(i) (TIMEPAGE - ((i)+1)*PGSIZE) // trapframes of threads
+#define RINGPAGE THREADFRAME(NTHREAD)               // struct ring, see ringsetup()
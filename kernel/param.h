@@ -1,5 +1,11 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define NTHREAD      16  // maximum threads per process, besides its first
+#define NIRQ         32  // PLIC interrupt sources we can route
+#ifndef IRQAFFINITY
+#define IRQAFFINITY  ((1L << NCPU) - 1)  // harts that take device IRQs at boot
+#endif
+#define NHPM          4  // hardware event counters we use, from hpmcounter3
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
@@ -11,3 +17,4 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define TICKNS   30000000  // nanoseconds per clock tick
@@ -0,0 +1,145 @@
+//
+// Hardware performance counters.
+//
+// The cycle and instret counters, and any event counters from
+// hpmcounter3 up, are per hart. To give each thread its own
+// counts, usertrap() charges what the counters advanced by since
+// usertrapret() to the thread, so that they count only user
+// space. perfread() reports the totals.
+//
+// Only machine mode may choose what the event counters count, so
+// perfctl() asks it to with an ecall; see hpmecall in kernelvec.S.
+// Events are the same on every hart. start.c found out how many
+// counters each hart has.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "perf.h"
+#include "defs.h"
+
+extern int nhpm[NCPU];
+
+struct spinlock perflock;
+uint64 hpmevent[NHPM];             // what perfctl() asked for
+uint64 hartevent[NCPU][NHPM];      // what each hart's counters count
+
+// read hpmcounter3+i; the csr number is part of the instruction.
+static uint64
+r_hpmcounter(int i)
+{
+  uint64 x = 0;
+
+  switch(i){
+  case 0: asm volatile("csrr %0, hpmcounter3" : "=r" (x)); break;
+  case 1: asm volatile("csrr %0, hpmcounter4" : "=r" (x)); break;
+  case 2: asm volatile("csrr %0, hpmcounter5" : "=r" (x)); break;
+  case 3: asm volatile("csrr %0, hpmcounter6" : "=r" (x)); break;
+  }
+  return x;
+}
+
+// ask machine mode to count event on hpmcounter3+i.
+static void
+hpmset(int i, uint64 event)
+{
+  register uint64 a1 asm("a1") = i;
+  register uint64 a2 asm("a2") = event;
+
+  asm volatile("ecall" : : "r" (a1), "r" (a2) : "memory");
+}
+
+void
+perfinit(void)
+{
+  initlock(&perflock, "perf");
+}
+
+// let user code read this hart's counters, and have them count
+// what perfctl() asked for.
+void
+perfinithart(void)
+{
+  w_scounteren(r_scounteren() | SCOUNTEREN_CY | SCOUNTEREN_IR);
+  for(int i = 0; i < nhpm[cpuid()]; i++)
+    w_scounteren(r_scounteren() | SCOUNTEREN_HPM(i));
+  perfsync();
+}
+
+// bring this hart's events up to date with perfctl()'s.
+// interrupts must be off.
+void
+perfsync(void)
+{
+  int id = cpuid();
+
+  for(int i = 0; i < nhpm[id]; i++){
+    if(hartevent[id][i] != hpmevent[i]){
+      hartevent[id][i] = hpmevent[i];
+      hpmset(i, hpmevent[i]);
+    }
+  }
+}
+
+// note where the counters are as p goes to user space.
+// the counters, not reset, go on from there whatever they count.
+void
+perfstamp(struct proc *p)
+{
+  p->perfstamp[0] = r_cycle();
+  p->perfstamp[1] = r_instret();
+  for(int i = 0; i < nhpm[cpuid()]; i++)
+    p->perfstamp[2+i] = r_hpmcounter(i);
+}
+
+// charge p for what the counters advanced by in user space.
+void
+perfcharge(struct proc *p)
+{
+  p->perf[0] += r_cycle() - p->perfstamp[0];
+  p->perf[1] += r_instret() - p->perfstamp[1];
+  for(int i = 0; i < nhpm[cpuid()]; i++)
+    p->perf[2+i] += r_hpmcounter(i) - p->perfstamp[2+i];
+}
+
+// Count event on event counter i of every hart. Threads' counts
+// of the counter's old event carry on with the new one. Returns
+// -1 if there is no such counter.
+int
+perfctl(int i, uint64 event)
+{
+  struct cpu *c;
+
+  if(i < 0 || i >= nhpm[cpuid()])
+    return -1;
+
+  acquire(&perflock);
+  hpmevent[i] = event;
+  perfsync();
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c != mycpu() && c->online)
+      ipisend(c, IPI_PERF);
+  release(&perflock);
+  return 0;
+}
+
+// Copy the calling thread's counts to user address addr.
+// Returns how many event counters there are.
+int
+perfread(uint64 addr)
+{
+  struct proc *p = myproc();
+  struct perfcount pc;
+
+  pc.cycles = p->perf[0];
+  pc.instret = p->perf[1];
+  for(int i = 0; i < NHPM; i++)
+    pc.hpm[i] = p->perf[2+i];
+  if(copyout(p->pagetable, addr, (char*)&pc, sizeof(pc)) < 0)
+    return -1;
+  return nhpm[cpuid()];
+}
@@ -0,0 +1,18 @@
+// Hardware performance counters; see perfctl() and perfread().
+// User code may also read cycle, instret and hpmcounter3 and up
+// directly, but those count for the whole hart.
+
+// events for perfctl(), numbered as qemu's virt machine does.
+#define PERF_NONE       0        // count nothing
+#define PERF_CYCLES     0x1
+#define PERF_INSTRET    0x2
+#define PERF_DTLBRMISS  0x10019  // data TLB misses by loads
+#define PERF_DTLBWMISS  0x1001b  // data TLB misses by stores
+#define PERF_ITLBMISS   0x10021  // instruction TLB misses
+
+// what a thread has counted while running in user space.
+struct perfcount {
+  uint64 cycles;
+  uint64 instret;
+  uint64 hpm[NHPM];  // perfctl()'s events, on hpmcounter3 and up
+};
@@ -7,22 +7,41 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "pollq.h"
+#include "poll.h"
 
-#define PIPESIZE 512
+// A pipe's buffer is a ring of whole pages, a power of two of
+// them so that nread and nwrite can wrap around.
+#define PIPEPAGES     4   // pages in a pipe's buffer, by default
+#define PIPEMAXPAGES 16   // most pages pipe2() will give a pipe
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data[PIPEMAXPAGES]; // the ring's pages
+  uint size;      // bytes in the ring
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rwaiting;   // readers asleep on nread
+  int wwaiting;   // writers asleep on nwrite
+  struct pollq pollq;  // poll()s waiting on either end
 };
 
+// Make a pipe whose buffer holds at least size bytes; 0 means
+// the default. Returns -1 if size is too big, or memory is short.
 int
-pipealloc(struct file **f0, struct file **f1)
+pipealloc(struct file **f0, struct file **f1, int size)
 {
   struct pipe *pi;
+  int npages, i;
+
+  if(size < 0 || size > PIPEMAXPAGES*PGSIZE)
+    return -1;
+  npages = PIPEPAGES;
+  if(size > 0)
+    for(npages = 1; npages*PGSIZE < size; npages *= 2)
+      ;
 
   pi = 0;
   *f0 = *f1 = 0;
@@ -30,11 +49,17 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(pi, 0, sizeof(*pi));
+  for(i = 0; i < npages; i++)
+    if((pi->data[i] = kalloc()) == 0)
+      goto bad;
+  pi->size = npages*PGSIZE;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
   initlock(&pi->lock, "pipe");
+  pollqinit(&pi->pollq);
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
@@ -46,8 +71,11 @@ pipealloc(struct file **f0, struct file **f1)
   return 0;
 
  bad:
-  if(pi)
+  if(pi){
+    for(i = 0; i < PIPEMAXPAGES && pi->data[i]; i++)
+      kfree(pi->data[i]);
     kfree((char*)pi);
+  }
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -66,17 +94,33 @@ pipeclose(struct pipe *pi, int writable)
     pi->readopen = 0;
     wakeup(&pi->nwrite);
   }
+  if(pi->pollq.head)
+    pollwake(&pi->pollq);
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    for(int i = 0; i < PIPEMAXPAGES && pi->data[i]; i++)
+      kfree(pi->data[i]);
     kfree((char*)pi);
   } else
     release(&pi->lock);
 }
 
+// Where byte off of the stream lives in the ring, and how many
+// bytes from there on are contiguous, up to the end of its page.
+static char*
+pipebuf(struct pipe *pi, uint off, uint *run)
+{
+  off %= pi->size;
+  *run = PGSIZE - off % PGSIZE;
+  return pi->data[off / PGSIZE] + off % PGSIZE;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
   int i = 0;
+  uint m, run;
+  char *dst;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
@@ -85,18 +129,34 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
+    if(pi->nwrite == pi->nread + pi->size){ //DOC: pipewrite-full
+      if(pi->rwaiting)
+        wakeup(&pi->nread);
+      pi->wwaiting++;
       sleep(&pi->nwrite, &pi->lock);
+      pi->wwaiting--;
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+      // copy as much as fits before the end of this ring page.
+      dst = pipebuf(pi, pi->nwrite, &run);
+      m = n - i;
+      if(m > pi->nread + pi->size - pi->nwrite)
+        m = pi->nread + pi->size - pi->nwrite;
+      if(m > run)
+        m = run;
+      if(copyin(pr->pagetable, dst, addr + i, m) == -1)
         break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      pi->nwrite += m;
+      i += m;
     }
   }
-  wakeup(&pi->nread);
+  // a reader only sleeps on an empty pipe, so any data
+  // is worth waking it for.
+  if(pi->rwaiting)
+    wakeup(&pi->nread);
+  // poll() links onto pollq before it looks at the pipe under
+  // pi->lock, so checking for pollers here loses no wakeups.
+  if(pi->pollq.head)
+    pollwake(&pi->pollq);
   release(&pi->lock);
 
   return i;
@@ -106,8 +166,9 @@ int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
   int i;
+  uint m, run;
+  char *src;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -115,16 +176,51 @@ piperead(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
+    pi->rwaiting++;
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+    pi->rwaiting--;
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    src = pipebuf(pi, pi->nread, &run);
+    m = n - i;
+    if(m > pi->nwrite - pi->nread)
+      m = pi->nwrite - pi->nread;
+    if(m > run)
+      m = run;
+    if(copyout(pr->pagetable, addr + i, src, m) == -1)
       break;
+    pi->nread += m;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  // writers sleep on a full pipe; let them go once at least a
+  // quarter of it is free, so that they write in big chunks.
+  if(pi->wwaiting && pi->nread + pi->size - pi->nwrite >= pi->size / 4)
+    wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  if(pi->pollq.head)
+    pollwake(&pi->pollq);
   release(&pi->lock);
   return i;
 }
+
+// Which of POLLIN, POLLOUT and POLLHUP hold for the read end,
+// or the write end if writable, and the pollq they change on.
+int
+pipepoll(struct pipe *pi, int writable, struct pollq **qp)
+{
+  int r = 0;
+
+  acquire(&pi->lock);
+  if(writable){
+    if(pi->nwrite != pi->nread + pi->size)
+      r |= POLLOUT;
+    if(pi->readopen == 0)
+      r |= POLLHUP;
+  } else {
+    if(pi->nread != pi->nwrite)
+      r |= POLLIN;
+    if(pi->writeopen == 0)
+      r |= POLLHUP;
+  }
+  release(&pi->lock);
+  *qp = &pi->pollq;
+  return r;
+}
@@ -2,15 +2,37 @@
 #include "param.h"
 #include "memlayout.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 
 //
 // the riscv Platform Level Interrupt Controller (PLIC).
 //
 
+// the device IRQs we serve.
+static int irqs[] = { UART0_IRQ, VIRTIO0_IRQ, VIRTIO1_IRQ, VIRTIO2_IRQ, VIRTIO3_IRQ };
+
+struct {
+  struct spinlock lock;
+  uint64 affinity[NIRQ];   // harts whose S-mode context may take each IRQ
+} plic;
+
+// interrupts claimed, by IRQ and hart. each hart only
+// updates its own column, so no lock is needed.
+static uint64 irqcount[NIRQ][NCPU];
+
 void
 plicinit(void)
 {
+  initlock(&plic.lock, "plic");
+
+  // the harts in IRQAFFINITY (make IRQAFFINITY=0x6, say)
+  // take every device's interrupts until irqaffinity()
+  // says otherwise. it should name a hart that boots.
+  for(int i = 0; i < NELEM(irqs); i++)
+    plic.affinity[irqs[i]] = IRQAFFINITY;
+
   // set desired IRQ priorities non-zero (otherwise disabled).
   *(uint32*)(PLIC + UART0_IRQ*4) = 1;
   *(uint32*)(PLIC + VIRTIO0_IRQ*4) = 1;
@@ -19,26 +41,91 @@ plicinit(void)
   *(uint32*)(PLIC + VIRTIO3_IRQ*4) = 1;
 }
 
+// set hart's S-mode enable bits from the affinity masks.
+// caller must hold plic.lock.
+static void
+plicenable(int hart)
+{
+  uint32 enable = 0;
+
+  for(int i = 0; i < NELEM(irqs); i++)
+    if(plic.affinity[irqs[i]] & (1L << hart))
+      enable |= 1 << irqs[i];
+  *(uint32*)PLIC_SENABLE(hart) = enable;
+}
+
 void
 plicinithart(void)
 {
   int hart = cpuid();
   
-  // set enable bits for this hart's S-mode
-  // for the uart and virtio disk.
-  // and the virtiogpu (I hope)
-  *(uint32*)PLIC_SENABLE(hart) = (1 << UART0_IRQ) | (1 << VIRTIO0_IRQ) | (1 << VIRTIO1_IRQ) | (1 << VIRTIO2_IRQ) | (1 << VIRTIO3_IRQ);
+  // set enable bits for this hart's S-mode for the
+  // uart, virtio disk, gpu, keyboard and sound, as
+  // far as their affinity allows.
+  acquire(&plic.lock);
+  plicenable(hart);
+  release(&plic.lock);
 
   // set this hart's S-mode priority threshold to 0.
   *(uint32*)PLIC_SPRIORITY(hart) = 0;
 }
 
+// Route irq to the harts in mask; mask 0 leaves it alone.
+// Returns the previous mask, or -1 if irq is not a device
+// we serve or mask has no hart that has started.
+uint64
+irqaffinity(int irq, uint64 mask)
+{
+  uint64 old;
+  int i, ok;
+
+  for(i = 0; i < NELEM(irqs); i++)
+    if(irqs[i] == irq)
+      break;
+  if(i == NELEM(irqs))
+    return -1;
+
+  ok = 0;
+  for(i = 0; i < NCPU; i++)
+    if((mask & (1L << i)) && cpus[i].online)
+      ok = 1;
+
+  acquire(&plic.lock);
+  old = plic.affinity[irq];
+  if(mask == 0){
+    release(&plic.lock);
+    return old;
+  }
+  if(!ok){
+    release(&plic.lock);
+    return -1;
+  }
+  plic.affinity[irq] = mask;
+  for(i = 0; i < NCPU; i++)
+    if(cpus[i].online)
+      plicenable(i);
+  release(&plic.lock);
+  return old;
+}
+
+// Copy out how many times each hart has taken irq,
+// as NCPU uint64s at user address addr.
+int
+irqstat(int irq, uint64 addr)
+{
+  if(irq <= 0 || irq >= NIRQ)
+    return -1;
+  return copyout(myproc()->pagetable, addr, (char*)irqcount[irq], sizeof(irqcount[irq]));
+}
+
 // ask the PLIC what interrupt we should serve.
 int
 plic_claim(void)
 {
   int hart = cpuid();
   int irq = *(uint32*)PLIC_SCLAIM(hart);
+  if(irq > 0 && irq < NIRQ)
+    irqcount[irq][hart]++;
   return irq;
 }
 
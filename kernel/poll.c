@@ -0,0 +1,212 @@
+//
+// Waiting for any of several files or devices at once.
+//
+// poll() links an entry onto the pollq of every source it is
+// asked about, then sleeps once. Whichever source changes first
+// calls pollwake(), which wakes every poll() waiting on it, and
+// each of those scans all its sources again.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "pollq.h"
+#include "poll.h"
+#include "timer.h"
+#include "defs.h"
+
+#define NPOLL (NOFILE+2)  // most entries in one poll(): every fd, kbd, gpu
+
+// the state of one poll() call. it sleeps on its own address.
+// w.t must come first, since a timeout wakes channel &w.t.
+struct pollwaiter {
+  struct timer t;  // the timeout, if any
+  int woken;       // a source has called pollwake()
+};
+
+// links a poll() call onto one source's pollq.
+struct pollent {
+  struct pollwaiter *w;
+  struct pollq *q;
+  struct pollent *next;
+};
+
+// serializes pollwake() against a poll() going to sleep.
+struct spinlock polllock;
+
+void
+pollinit(void)
+{
+  initlock(&polllock, "poll");
+}
+
+void
+pollqinit(struct pollq *q)
+{
+  initlock(&q->lock, "pollq");
+  q->head = 0;
+}
+
+// Wake every poll() waiting on q.
+void
+pollwake(struct pollq *q)
+{
+  struct pollent *e;
+
+  acquire(&q->lock);
+  for(e = q->head; e; e = e->next){
+    acquire(&polllock);
+    e->w->woken = 1;
+    release(&polllock);
+    wakeup(e->w);
+  }
+  release(&q->lock);
+}
+
+static void
+pollqadd(struct pollq *q, struct pollent *e)
+{
+  e->q = q;
+  acquire(&q->lock);
+  e->next = q->head;
+  q->head = e;
+  release(&q->lock);
+}
+
+static void
+pollqdel(struct pollent *e)
+{
+  struct pollent **pp;
+
+  acquire(&e->q->lock);
+  for(pp = &e->q->head; *pp != e; pp = &(*pp)->next)
+    ;
+  *pp = e->next;
+  release(&e->q->lock);
+}
+
+// the timer can't touch w, which may be gone by the
+// time this runs; it wakes w's address, under polllock
+// so that the wakeup can't fall between poll()'s check
+// of t->pending and its sleep.
+static void
+polltimeout(struct timer *t)
+{
+  acquire(&polllock);
+  wakeup(t);
+  release(&polllock);
+}
+
+// What the source behind pfd reports ready now,
+// and in *qp its pollq, if it has one.
+static int
+pollsrc(struct pollfd *pfd, struct file *f, struct pollq **qp)
+{
+  if(pfd->fd == POLLKBD)
+    return kbdpoll(qp) ? POLLIN : 0;
+  if(pfd->fd == POLLGPU)
+    return gpupoll(qp) ? POLLIN : 0;
+  return filepoll(f, qp);
+}
+
+// Which of the events in pfd are ready now. On the first scan,
+// when e is not 0, link e onto the source's pollq, if it has one,
+// before looking: a source that becomes ready after the look then
+// finds e on its pollq, and its pollwake() stops the sleep.
+static int
+pollscan(struct pollfd *pfd, struct file *f, struct pollent *e)
+{
+  struct pollq *q = 0;
+  int r;
+
+  if(pfd->fd != POLLKBD && pfd->fd != POLLGPU && f == 0)
+    return POLLNVAL;
+  r = pollsrc(pfd, f, &q);
+  if(e && q){
+    pollqadd(q, e);
+    r = pollsrc(pfd, f, &q);
+  }
+  return r & (pfd->events | POLLHUP);
+}
+
+// Wait until one of the n pollfds at addr is ready, or timeout
+// nanoseconds pass. Fills in their revents, and returns how many
+// have some, 0 on timeout, or -1 on error or if killed.
+int
+poll(uint64 addr, int n, uint64 timeout)
+{
+  struct proc *p = myproc();
+  struct pollfd pfds[NPOLL];
+  struct file *files[NPOLL];
+  struct pollent ents[NPOLL];
+  struct pollwaiter w;
+  int i, ready, armed;
+
+  if(n < 0 || n > NPOLL)
+    return -1;
+  if(copyin(p->pagetable, (char*)pfds, addr, n * sizeof(pfds[0])) < 0)
+    return -1;
+
+  // hold the files, so that another thread closing
+  // one can't free a pollq we are linked onto.
+  for(i = 0; i < n; i++){
+    ents[i].w = &w;
+    ents[i].q = 0;
+    files[i] = fdget(pfds[i].fd);
+  }
+
+  w.t.pending = 0;
+  armed = timeout != POLLFOREVER && timeout != 0;
+  if(armed){
+    w.t.deadline = r_time() + (timeout + NSPERMTIME - 1) / NSPERMTIME;
+    w.t.fn = polltimeout;
+    timer_add(&w.t);
+  }
+
+  for(int first = 1; ; first = 0){
+    acquire(&polllock);
+    w.woken = 0;
+    release(&polllock);
+
+    ready = 0;
+    for(i = 0; i < n; i++){
+      if(pfds[i].fd < 0 && pfds[i].fd != POLLKBD && pfds[i].fd != POLLGPU){
+        pfds[i].revents = 0;
+        continue;
+      }
+      pfds[i].revents = pollscan(&pfds[i], files[i], first ? &ents[i] : 0);
+      if(pfds[i].revents)
+        ready++;
+    }
+    if(ready || timeout == 0 || killed(p))
+      break;
+
+    acquire(&polllock);
+    if(!w.woken && (timeout == POLLFOREVER || w.t.pending))
+      sleep(&w, &polllock);
+    release(&polllock);
+    if(timeout != POLLFOREVER && !w.t.pending)
+      timeout = 0;  // scan once more, then give up
+  }
+
+  if(armed)
+    timer_del(&w.t);
+  for(i = 0; i < n; i++){
+    if(ents[i].q)
+      pollqdel(&ents[i]);
+    if(files[i])
+      fileclose(files[i]);
+  }
+
+  if(killed(p))
+    return -1;
+  if(copyout(p->pagetable, addr, (char*)pfds, n * sizeof(pfds[0])) < 0)
+    return -1;
+  return ready;
+}
@@ -0,0 +1,17 @@
+// poll() requests and results.
+struct pollfd {
+  int fd;        // file descriptor, or POLLKBD or POLLGPU
+  short events;  // POLLIN and/or POLLOUT to wait for
+  short revents; // what is ready, filled in by poll()
+};
+
+#define POLLIN   0x001  // reading won't block
+#define POLLOUT  0x004  // writing won't block
+#define POLLHUP  0x010  // the other end of a pipe is closed
+#define POLLNVAL 0x020  // fd is not open
+
+// pseudo-descriptors for events that have no file.
+#define POLLKBD  -2     // POLLIN: a keyboard event is waiting for kbdcmd()
+#define POLLGPU  -3     // POLLIN: the gpu has finished its last command
+
+#define POLLFOREVER (~0UL) // timeout that never expires
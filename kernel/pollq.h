@@ -0,0 +1,6 @@
+// poll() calls waiting for an event source, such as a pipe,
+// to become ready. The source calls pollwake() when it might be.
+struct pollq {
+  struct spinlock lock;
+  struct pollent *head;  // poll() calls waiting, see poll.c
+};
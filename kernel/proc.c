@@ -4,6 +4,10 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "procstat.h"
+#include "timer.h"
+#include "trace.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -12,11 +16,27 @@ struct proc proc[NPROC];
 
 struct proc *initproc;
 
+// pid_lock protects nextpid, the pid hash, and the free list.
 int nextpid = 1;
 struct spinlock pid_lock;
 
+#define NPIDHASH NPROC
+struct proc *pidhash[NPIDHASH];  // in-use processes, by pid
+struct proc *freeprocs;          // UNUSED processes
+
+// sleeping processes, hashed by wait channel.
+#define NCHANQ 64
+struct chanq {
+  struct spinlock lock;
+  struct proc *head;
+} chanqs[NCHANQ];
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void runqput(struct cpu *c, struct proc *p);
+static struct cpu *placecpu(struct proc *p, struct cpu *pref);
+static struct proc *lockpid(int pid);
+static void killlocked(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
@@ -26,6 +46,13 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// the wait queue for chan.
+static struct chanq*
+chanq(void *chan)
+{
+  return &chanqs[((uint64)chan * 0x9E3779B97F4A7C15UL) >> 58];
+}
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -48,13 +75,21 @@ void
 procinit(void)
 {
   struct proc *p;
+  struct cpu *c;
+  struct chanq *q;
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
+  for(c = cpus; c < &cpus[NCPU]; c++)
+      initlock(&c->rqlock, "runq");
+  for(q = chanqs; q < &chanqs[NCHANQ]; q++)
+      initlock(&q->lock, "chanq");
+  for(p = &proc[NPROC-1]; p >= proc; p--) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
+      p->hashnext = freeprocs;
+      freeprocs = p;
   }
 }
 
@@ -89,41 +124,51 @@ myproc(void)
   return p;
 }
 
-int
-allocpid()
+// Give p a new pid, and enter it in the pid hash.
+// Caller must hold p->lock.
+static void
+allocpid(struct proc *p)
 {
-  int pid;
-  
+  struct proc **h;
+
   acquire(&pid_lock);
-  pid = nextpid;
+  p->pid = nextpid;
   nextpid = nextpid + 1;
+  h = &pidhash[p->pid % NPIDHASH];
+  p->hashnext = *h;
+  *h = p;
   release(&pid_lock);
-
-  return pid;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
+// Take an UNUSED proc from the free list.
+// If there is one, initialize state required to run in the kernel,
 // and return with p->lock held.
+// Its trapframe goes at tfva in pagetable, or in a new page
+// table of its own if pagetable is 0.
 // If there are no free procs, or a memory allocation fails, return 0.
 static struct proc*
-allocproc(void)
+allocproc(pagetable_t pagetable, uint64 tfva)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
-  }
-  return 0;
+  acquire(&pid_lock);
+  p = freeprocs;
+  if(p)
+    freeprocs = p->hashnext;
+  release(&pid_lock);
+  if(p == 0)
+    return 0;
 
-found:
-  p->pid = allocpid();
+  // freeproc() may not have released it yet.
+  acquire(&p->lock);
+  allocpid(p);
   p->state = USED;
+  p->policy = SCHED_NORMAL;
+  p->prio = 0;
+  p->affinity = ~0UL;
+  p->utime = p->stime = 0;
+  p->nvcsw = p->nivcsw = p->nfaults = 0;
+  memset(p->perf, 0, sizeof(p->perf));
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -132,12 +177,25 @@ found:
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
+  p->tg = p;
+  p->tfva = tfva;
+  if(pagetable == 0){
+    // An empty user page table.
+    p->pagetable = proc_pagetable(p);
+    if(p->pagetable == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+  } else {
+    // A thread, sharing pagetable with the rest of its group.
+    if(mappages(pagetable, tfva, PGSIZE,
+                (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    p->pagetable = pagetable;
   }
 
   // Set up new context to start executing at forkret,
@@ -150,25 +208,45 @@ found:
 }
 
 // free a proc structure and the data hanging from it,
-// including user pages.
-// p->lock must be held.
+// including user pages, unless it is a thread, whose
+// user pages belong to its group leader.
+// p->lock must be held, and wait_lock too if p is a thread.
 static void
 freeproc(struct proc *p)
 {
+  struct proc **h;
+
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+  if(p->pagetable){
+    if(p->tfva == TRAPFRAME){
+      ringfree(p);
+      proc_freepagetable(p->pagetable, p->sz);
+    } else {
+      uvmunmap(p->pagetable, p->tfva, 1, 0);
+      p->tg->threadslots &= ~(1 << ((TIMEPAGE - p->tfva) / PGSIZE - 1));
+    }
+  }
   p->pagetable = 0;
+  p->tg = 0;
   p->sz = 0;
-  p->pid = 0;
   p->parent = 0;
+  p->sibling = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
+
+  acquire(&pid_lock);
+  for(h = &pidhash[p->pid % NPIDHASH]; *h != p; h = &(*h)->hashnext)
+    ;
+  *h = p->hashnext;
+  p->hashnext = freeprocs;
+  freeprocs = p;
+  release(&pid_lock);
+  p->pid = 0;
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -202,6 +280,16 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the time page read-only for user code; see timenow()
+  // in user/ulib.c.
+  if(mappages(pagetable, TIMEPAGE, PGSIZE,
+              (uint64)timepage, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -212,6 +300,7 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, TIMEPAGE, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -234,7 +323,7 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0, TRAPFRAME);
   initproc = p;
   
   // allocate one user page and copy initcode's instructions
@@ -250,28 +339,61 @@ userinit(void)
   p->cwd = namei("/");
 
   p->state = RUNNABLE;
+  runqput(mycpu(), p);
 
   release(&p->lock);
 }
 
+// pages growproc() unmaps before each shootdown.
+#define SHRINKBATCH 64
+
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int
+// Return the old size on success, -1 on failure.
+uint64
 growproc(int n)
 {
-  uint64 sz;
-  struct proc *p = myproc();
+  uint64 sz, oldsz, newsz, a, pas[SHRINKBATCH];
+  struct proc *p = myproc()->tg;
+  int i, npa;
 
-  sz = p->sz;
+  // the group's threads may call sbrk() at once.
+  acquire(&p->lock);
+  sz = oldsz = p->sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&p->lock);
       return -1;
     }
-  } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    p->sz = sz;
+  } else if(n < 0 && (newsz = sz + n) < sz){
+    // another thread may still reach a page through its TLB
+    // until the shootdown, so unmap a batch of pages, shoot,
+    // and only then free them. other cpus, waiting for this
+    // lock with interrupts off, could not answer a shootdown,
+    // so it happens with the lock released.
+    while(PGROUNDUP(newsz) < PGROUNDUP(sz)){
+      npa = 0;
+      for(a = PGROUNDUP(sz); a > PGROUNDUP(newsz) && npa < SHRINKBATCH; a -= PGSIZE){
+        pas[npa++] = walkaddr(p->pagetable, a - PGSIZE);
+        uvmunmap(p->pagetable, a - PGSIZE, 1, 0);
+      }
+      p->sz = sz = a;
+      release(&p->lock);
+      tlbshootdown(p->pagetable);
+      for(i = 0; i < npa; i++)
+        kfree((void*)pas[i]);
+      acquire(&p->lock);
+      // another thread moved the break meanwhile;
+      // leave the memory the way it left it.
+      if(p->sz != sz){
+        release(&p->lock);
+        return oldsz;
+      }
+    }
+    p->sz = newsz;
   }
-  p->sz = sz;
-  return 0;
+  release(&p->lock);
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -282,19 +404,20 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *tg = p->tg;
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0, TRAPFRAME)) == 0){
     return -1;
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  if(uvmcopy(p->pagetable, np->pagetable, tg->sz) < 0){
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  np->sz = tg->sz;
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -302,29 +425,139 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
+  np->cwd = idup(tg->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  np->policy = p->policy;
+  np->prio = p->prio;
+  np->affinity = p->affinity;
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  // increment reference counts on open file descriptors,
+  // which a sibling thread may be closing; np can't
+  // run yet, so it needn't be locked meanwhile.
+  acquire(&tg->lock);
   for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if(tg->ofile[i])
+      np->ofile[i] = filedup(tg->ofile[i]);
+  release(&tg->lock);
+
+  // a thread's children belong to its group leader.
+  acquire(&wait_lock);
+  np->parent = tg;
+  np->sibling = tg->children;
+  tg->children = np;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  runqput(placecpu(np, 0), np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread that shares the caller's memory, open files
+// and current directory, and starts running fn(arg) on the
+// stack whose top is stack. The thread is a child of its group
+// leader, and ends with exit(), not by returning from fn.
+// Returns the new thread's pid, or -1.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *tg = p->tg;
+
+  // Claim a THREADFRAME slot for its trapframe.
+  acquire(&wait_lock);
+  for(i = 0; i < NTHREAD; i++)
+    if((tg->threadslots & (1 << i)) == 0)
+      break;
+  if(i < NTHREAD)
+    tg->threadslots |= 1 << i;
+  release(&wait_lock);
+  if(i == NTHREAD)
+    return -1;
+
+  if((np = allocproc(tg->pagetable, THREADFRAME(i))) == 0){
+    acquire(&wait_lock);
+    tg->threadslots &= ~(1 << i);
+    release(&wait_lock);
+    return -1;
+  }
+  np->tg = tg;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = -1;  // returning from fn faults
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->policy = p->policy;
+  np->prio = p->prio;
+  np->affinity = p->affinity;
+
   pid = np->pid;
 
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  np->parent = tg;
+  np->sibling = tg->children;
+  tg->children = np;
   release(&wait_lock);
 
   acquire(&np->lock);
   np->state = RUNNABLE;
+  runqput(placecpu(np, 0), np);
   release(&np->lock);
 
   return pid;
 }
 
+// Kill p's threads and free them once they have exited,
+// so that nothing is left using p's memory and files.
+// Caller must hold wait_lock.
+static void
+killthreads(struct proc *p)
+{
+  struct proc *pp, **link;
+  int running;
+
+  for(;;){
+    running = 0;
+    for(link = &p->children; (pp = *link) != 0; ){
+      if(pp->tg != p){
+        link = &pp->sibling;
+        continue;
+      }
+      acquire(&pp->lock);
+      if(pp->state == ZOMBIE){
+        *link = pp->sibling;
+        freeproc(pp);
+        release(&pp->lock);
+        continue;
+      }
+      killlocked(pp);
+      release(&pp->lock);
+      running++;
+      link = &pp->sibling;
+    }
+    if(running == 0)
+      return;
+    // each one wakes us as it exits.
+    sleep(p, &wait_lock);
+  }
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -332,17 +565,24 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibling){
+    pp->parent = initproc;
+    if(pp->sibling == 0)
+      break;
   }
+  pp->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait().
+// A thread exits alone, and its group leader's wait() collects
+// it. A group leader kills and collects its threads first.
 void
 exit(int status)
 {
@@ -351,19 +591,25 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  if(p->tg == p){
+    acquire(&wait_lock);
+    killthreads(p);
+    release(&wait_lock);
+
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(p->ofile[fd]){
+        struct file *f = p->ofile[fd];
+        fileclose(f);
+        p->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+    begin_op();
+    iput(p->cwd);
+    end_op();
+    p->cwd = 0;
+  }
 
   acquire(&wait_lock);
 
@@ -385,59 +631,267 @@ exit(int status)
   panic("zombie exit");
 }
 
-// Wait for a child process to exit and return its pid.
+// Wait for a child process, or a thread of our group,
+// to exit and return its pid.
 // Return -1 if this process has no children.
 int
 wait(uint64 addr)
 {
-  struct proc *pp;
-  int havekids, pid;
+  struct proc *pp, **link;
+  int pid;
   struct proc *p = myproc();
+  struct proc *tg = p->tg;
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
+    // Scan through our children looking for exited ones.
+    for(link = &tg->children; (pp = *link) != 0; link = &pp->sibling){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      if(pp->state == ZOMBIE){
+        // Found one.
+        pid = pp->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                                sizeof(pp->xstate)) < 0) {
           release(&pp->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        *link = pp->sibling;
+        freeproc(pp);
         release(&pp->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&pp->lock);
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(tg->children == 0 || killed(p)){
       release(&wait_lock);
       return -1;
     }
     
     // Wait for a child to exit.
-    sleep(p, &wait_lock);  //DOC: wait-sleep
+    sleep(tg, &wait_lock);  //DOC: wait-sleep
+  }
+}
+
+// Does q run before p? SCHED_FIFO processes come before
+// SCHED_NORMAL ones, in priority order.
+static int
+runsbefore(struct proc *q, struct proc *p)
+{
+  if(q->policy != SCHED_FIFO)
+    return 0;
+  return p->policy != SCHED_FIFO || q->prio > p->prio;
+}
+
+// Add p to c's run queue, behind every process that runs before it
+// and every process of equal standing, so that each priority level
+// is first-in first-out. If c is another cpu that is idle, or is
+// running something p should preempt, interrupt it.
+// Caller must hold p->lock and have set p->state to RUNNABLE.
+static void
+runqput(struct cpu *c, struct proc *p)
+{
+  struct proc *q, *prev;
+  int kick;
+
+  acquire(&c->rqlock);
+  p->cpu = c - cpus;
+  prev = 0;
+  for(q = c->rqhead; q && !runsbefore(p, q); q = q->rqnext)
+    prev = q;
+  p->rqnext = q;
+  if(prev)
+    prev->rqnext = p;
+  else
+    c->rqhead = p;
+  if(q == 0)
+    c->rqtail = p;
+  c->rqlen++;
+  // c->proc may change under us; at worst c takes a
+  // needless interrupt, or waits for its next tick.
+  q = c->proc;
+  kick = c != mycpu() && (c->idle || (q && runsbefore(p, q)));
+  release(&c->rqlock);
+
+  if(kick)
+    ipisend(c, IPI_RESCHED);
+}
+
+// Unlink p from c's run queue; prev is p's predecessor, or 0.
+// Caller must hold c->rqlock.
+static void
+runqunlink(struct cpu *c, struct proc *prev, struct proc *p)
+{
+  if(prev)
+    prev->rqnext = p->rqnext;
+  else
+    c->rqhead = p->rqnext;
+  if(c->rqtail == p)
+    c->rqtail = prev;
+  p->rqnext = 0;
+  c->rqlen--;
+}
+
+// Remove and return the process at the head of c's run queue,
+// or 0 if it is empty.
+static struct proc*
+runqget(struct cpu *c)
+{
+  struct proc *p;
+
+  acquire(&c->rqlock);
+  p = c->rqhead;
+  if(p)
+    runqunlink(c, 0, p);
+  release(&c->rqlock);
+  return p;
+}
+
+// Take a process from the longest run queue of some other cpu.
+// Queue lengths are read without locks; they only steer the choice.
+// A process that the victim has just put back from yield() is
+// skipped, since the victim is about to run it with a warm cache,
+// and so is any process whose affinity excludes this cpu.
+static struct proc*
+runqsteal(struct cpu *c)
+{
+  struct cpu *v, *victim;
+  struct proc *p, *prev;
+  int most;
+
+  victim = 0;
+  most = 0;
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v != c && v->online && v->rqlen > most){
+      most = v->rqlen;
+      victim = v;
+    }
+  }
+  if(victim == 0)
+    return 0;
+
+  acquire(&victim->rqlock);
+  prev = 0;
+  for(p = victim->rqhead; p; prev = p, p = p->rqnext){
+    if(p != victim->proc && (p->affinity & (1L << (c - cpus)))){
+      runqunlink(victim, prev, p);
+      break;
+    }
   }
+  release(&victim->rqlock);
+  return p;
+}
+
+// Remove p from whichever run queue holds it.
+// Returns 1 if it was queued, 0 if not.
+// Caller must hold p->lock.
+static int
+runqremove(struct proc *p)
+{
+  struct cpu *c = &cpus[p->cpu];
+  struct proc *q, *prev;
+
+  acquire(&c->rqlock);
+  prev = 0;
+  for(q = c->rqhead; q; prev = q, q = q->rqnext){
+    if(q == p){
+      runqunlink(c, prev, p);
+      break;
+    }
+  }
+  release(&c->rqlock);
+  return q != 0;
+}
+
+// Choose the cpu whose run queue p should join: pref if
+// it is online and p's affinity allows it, otherwise the
+// allowed online cpu with the shortest run queue.
+// pref may be 0 to always pick the shortest queue.
+// Caller must hold p->lock.
+static struct cpu*
+placecpu(struct proc *p, struct cpu *pref)
+{
+  struct cpu *c, *best;
+
+  if(pref && pref->online && (p->affinity & (1L << (pref - cpus))))
+    return pref;
+  best = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->online || (p->affinity & (1L << (c - cpus))) == 0)
+      continue;
+    if(best == 0 || c->rqlen < best->rqlen)
+      best = c;
+  }
+  if(best == 0)
+    best = pref ? pref : mycpu();
+  return best;
+}
+
+// Should the running process p give up this cpu at a clock tick?
+// SCHED_NORMAL processes always do. A SCHED_FIFO process keeps
+// the cpu unless a higher-priority one is waiting for it, or
+// its affinity no longer includes this cpu.
+int
+needresched(struct proc *p)
+{
+  struct cpu *c;
+  struct proc *q;
+  int r;
+
+  push_off();
+  c = mycpu();
+  if(p->policy != SCHED_FIFO || (p->affinity & (1L << cpuid())) == 0){
+    pop_off();
+    return 1;
+  }
+  acquire(&c->rqlock);
+  q = c->rqhead;
+  r = q != 0 && runsbefore(q, p);
+  release(&c->rqlock);
+  pop_off();
+  return r;
+}
+
+// Nothing to run: wait for an interrupt with this cpu's clock
+// tick stopped. It wakes for its own timers, for device
+// interrupts, or for an IPI from runqput().
+static void
+idle(struct cpu *c)
+{
+  intr_off();
+  acquire(&c->rqlock);
+  c->idle = 1;
+  release(&c->rqlock);
+
+  // a process may have been queued here just before c->idle
+  // was set; only wait if there is still nothing to run. one
+  // queued after will come with an IPI, which ends the wfi.
+  if(c->rqlen == 0){
+    uint64 t0 = r_time();
+    tickstop();
+    wfi();
+    statidle(t0);
+  }
+
+  acquire(&c->rqlock);
+  c->idle = 0;
+  release(&c->rqlock);
+  tickstart();
+  intr_on();
 }
 
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - choose a process to run, from this cpu's run queue,
+//    or stolen from the busiest other cpu if ours is empty.
+//  - if there is none, idle() until an interrupt.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -448,26 +902,35 @@ scheduler(void)
   struct cpu *c = mycpu();
   
   c->proc = 0;
+  c->online = 1;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
+    if((p = runqget(c)) == 0 && (p = runqsteal(c)) == 0){
+      idle(c);
+      continue;
     }
+
+    // A stolen process may still be on its way out of another
+    // cpu's sched(); acquiring p->lock waits for that to finish.
+    acquire(&p->lock);
+    if(p->state == RUNNABLE) {
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      p->cpu = c - cpus;
+      c->proc = p;
+      if(tracemask & TRACE_SCHED)
+        trace(TR_SWITCHIN, 0, 0);
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
+    }
+    release(&p->lock);
   }
 }
 
@@ -494,17 +957,25 @@ sched(void)
     panic("sched interruptible");
 
   intena = mycpu()->intena;
+  if(tracemask & TRACE_SCHED)
+    trace(TR_SWITCHOUT, p->state, 0);
+  p->stime += r_time() - p->tstamp;
   swtch(&p->context, &mycpu()->context);
+  p->tstamp = r_time();
   mycpu()->intena = intena;
 }
 
 // Give up the CPU for one scheduling round.
+// The process goes back on this cpu's run queue, so it
+// keeps its cache affinity unless another cpu steals it.
 void
 yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  p->nivcsw++;
+  runqput(placecpu(p, mycpu()), p);
   sched();
   release(&p->lock);
 }
@@ -517,6 +988,7 @@ forkret(void)
   static int first = 1;
 
   // Still holding p->lock from scheduler.
+  myproc()->tstamp = r_time();
   release(&myproc()->lock);
 
   if (first) {
@@ -536,50 +1008,101 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct chanq *q = chanq(chan);
+  struct proc **pp;
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once we hold chan's wait queue lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks the queue, then p->lock),
   // so it's okay to release lk.
 
-  acquire(&p->lock);  //DOC: sleeplock1
+  acquire(&q->lock);  //DOC: sleeplock1
+  acquire(&p->lock);
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
+  if(tracemask & TRACE_SLEEP)
+    trace(TR_SLEEP, (uint64)chan, 0);
+  p->chnext = q->head;
+  q->head = p;
+  release(&q->lock);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // Leave the wait queue. wakeup() and kill() leave
+  // that to us, since they hold p->lock, which must
+  // not be held while acquiring q->lock.
+  acquire(&q->lock);
+  for(pp = &q->head; *pp != p; pp = &(*pp)->chnext)
+    ;
+  *pp = p->chnext;
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
 // Wake up all processes sleeping on chan.
+// Each goes on the run queue of the cpu that last ran it.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
+{
+  wakeupn(chan, -1);
+}
+
+// Wake up at most n processes sleeping on chan, or all
+// of them if n is negative. Returns how many were woken.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
 {
   struct proc *p;
+  struct chanq *q = chanq(chan);
+  int woken = 0;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  acquire(&q->lock);
+  for(p = q->head; p && woken != n; p = p->chnext) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        runqput(placecpu(p, &cpus[p->cpu]), p);
+        woken++;
+        if(tracemask & TRACE_SLEEP)
+          trace(TR_WAKEUP, (uint64)chan, p->pid);
       }
       release(&p->lock);
     }
   }
+  release(&q->lock);
+  return woken;
 }
 
-// Kill the process with the given pid.
+// Mark p killed, and wake it if it is sleeping.
+// Caller must hold p->lock.
+static void
+killlocked(struct proc *p)
+{
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+    runqput(placecpu(p, &cpus[p->cpu]), p);
+  }
+}
+
+// Kill the process with the given pid. Killing a group
+// leader kills its threads too; see exit().
 // The victim won't exit until it tries to return
 // to user space (see usertrap() in trap.c).
 int
@@ -587,20 +1110,103 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
+  if(pid == 0 || (p = lockpid(pid)) == 0)
+    return -1;
+  killlocked(p);
+  release(&p->lock);
+  return 0;
+}
+
+// Find the process with the given pid, or the caller if pid is 0,
+// and return it with p->lock held. Returns 0 if there is none.
+static struct proc*
+lockpid(int pid)
+{
+  struct proc *p;
+
+  if(pid == 0){
+    p = myproc();
     acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+    return p;
+  }
+  if(pid < 0)
+    return 0;
+  acquire(&pid_lock);
+  for(p = pidhash[pid % NPIDHASH]; p; p = p->hashnext)
+    if(p->pid == pid)
+      break;
+  release(&pid_lock);
+  if(p == 0)
+    return 0;
+
+  // p may have exited and been reused since we let go
+  // of pid_lock; check again now that it can't change.
+  acquire(&p->lock);
+  if(p->pid == pid && p->state != UNUSED)
+    return p;
+  release(&p->lock);
+  return 0;
+}
+
+// Set the scheduling policy and priority of process pid
+// (0 means the caller). A negative policy just reports the
+// current settings, as policy<<8 | prio.
+// Returns -1 if there is no such process or the settings are bad.
+int
+setsched(int pid, int policy, int prio)
+{
+  struct proc *p;
+  int old;
+
+  if(policy == SCHED_NORMAL && prio != 0)
+    return -1;
+  if(policy == SCHED_FIFO && (prio < 1 || prio > SCHED_MAXPRIO))
+    return -1;
+  if(policy > SCHED_FIFO)
+    return -1;
+  if((p = lockpid(pid)) == 0)
+    return -1;
+  old = p->policy << 8 | p->prio;
+  if(policy >= 0){
+    p->policy = policy;
+    p->prio = prio;
+    // requeue, since its place in the queue depends on these.
+    if(p->state == RUNNABLE && runqremove(p))
+      runqput(&cpus[p->cpu], p);
+  }
+  release(&p->lock);
+  return old;
+}
+
+// Restrict process pid (0 means the caller) to the cpus in mask.
+// A zero mask just reports the current one.
+// Returns the previous mask, or -1 if there is no such process
+// or mask names no cpu that is running.
+uint64
+setaffinity(int pid, uint64 mask)
+{
+  struct proc *p;
+  struct cpu *c;
+  uint64 old, online;
+
+  online = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->online)
+      online |= 1L << (c - cpus);
+  if(mask != 0 && (mask & online) == 0)
+    return -1;
+  if((p = lockpid(pid)) == 0)
+    return -1;
+  old = p->affinity;
+  if(mask != 0){
+    p->affinity = mask;
+    // a running process moves at its next clock tick,
+    // see needresched(); a waiting one moves now.
+    if(p->state == RUNNABLE && runqremove(p))
+      runqput(placecpu(p, &cpus[p->cpu]), p);
   }
-  return -1;
+  release(&p->lock);
+  return old;
 }
 
 void
@@ -652,6 +1258,47 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Copy accounting for up to n in-use processes, as struct
+// procstats, to user address addr. Returns how many were copied.
+int
+procstat(uint64 addr, int n)
+{
+  struct proc *p;
+  struct procstat ps;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&wait_lock);
+    acquire(&p->lock);
+    if(p->state == UNUSED || p->tg == 0){
+      release(&p->lock);
+      release(&wait_lock);
+      continue;
+    }
+    ps.pid = p->pid;
+    ps.ppid = p->parent ? p->parent->pid : 0;
+    ps.tgid = p->tg->pid;
+    ps.state = p->state;
+    ps.cpu = p->cpu;
+    safestrcpy(ps.name, p->name, sizeof(ps.name));
+    ps.utime = p->utime * NSPERMTIME;
+    ps.stime = p->stime * NSPERMTIME;
+    ps.nvcsw = p->nvcsw;
+    ps.nivcsw = p->nivcsw;
+    ps.nfaults = p->nfaults;
+    ps.sz = p->tg->sz;
+    // a zombie's memory stays until its parent's wait().
+    ps.rss = p->pagetable ? uvmresident(p->pagetable, ps.sz) : 0;
+    release(&p->lock);
+    release(&wait_lock);
+
+    if(copyout(myproc()->pagetable, addr + i*sizeof(ps), (char*)&ps, sizeof(ps)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -678,6 +1325,8 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    printf(" cpu %dms csw %d/%d", (int)((p->utime + p->stime) / (MTIME_FREQ / 1000)),
+           (int)p->nvcsw, (int)p->nivcsw);
     printf("\n");
   }
 }
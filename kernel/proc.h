@@ -24,10 +24,27 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int online;                 // Has this cpu entered scheduler()?
+  int idle;                   // Waiting in wfi with its tick stopped?
+  int ipipending;             // IPI_* bits other cpus have sent; see ipi.c.
+  int tlbacks;                // TLB shootdowns handled.
+  uint64 trapfp;              // s0 of the code kerneltrap() interrupted.
+
+  // rqlock must be held when using these:
+  struct spinlock rqlock;
+  struct proc *rqhead;        // RUNNABLE processes waiting for this cpu.
+  struct proc *rqtail;
+  int rqlen;                  // Number of processes on the run queue.
 };
 
 extern struct cpu cpus[NCPU];
 
+// reasons for an inter-processor interrupt.
+#define IPI_RESCHED 1  // a process that should run now was queued
+#define IPI_TLB     2  // flush the TLB for tlbshootdown()
+#define IPI_PROF    4  // start the profiler's timer; see prof.c
+#define IPI_PERF    8  // perfctl() changed the counters' events
+
 // per-process data for the trap handling code in trampoline.S.
 // sits in a page by itself just under the trampoline page in the
 // user page table. not specially mapped in the kernel page table.
@@ -91,17 +108,52 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // cpu that last ran us, or whose run queue holds us
+  int policy;                  // SCHED_NORMAL or SCHED_FIFO
+  int prio;                    // SCHED_FIFO priority, higher runs first
+  uint64 affinity;             // Mask of cpus allowed to run us
+
+  // the run queue lock of cpus[cpu] must be held when using this:
+  struct proc *rqnext;         // Next process on the run queue
 
-  // wait_lock must be held when using this:
+  // the lock of chan's wait queue must be held when using this:
+  struct proc *chnext;         // Next process on the wait queue
+
+  // pid_lock must be held when using this:
+  struct proc *hashnext;       // Next in pid hash chain, or free list
+
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children, until wait() frees them
+  struct proc *sibling;        // Next child of our parent
+  uint threadslots;            // THREADFRAME slots our threads are using
+
+  // fixed when the process or thread is created.
+  struct proc *tg;             // Thread group leader; p itself if not a thread
+  uint64 tfva;                 // User address of trapframe
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
-  uint64 sz;                   // Size of process memory (bytes)
-  pagetable_t pagetable;       // User page table
+  pagetable_t pagetable;       // User page table, shared with tg
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
+  char name[16];               // Process name (debugging)
+
+  // accounting, kept by the process itself; see procstat().
+  uint64 utime;                // mtime units spent in user space
+  uint64 stime;                // mtime units spent running in the kernel
+  uint64 tstamp;               // mtime when utime or stime was last charged
+  uint64 nvcsw;                // context switches because it slept
+  uint64 nivcsw;               // context switches because it was preempted
+  uint64 nfaults;              // page faults
+  uint64 perf[2+NHPM];         // user-space cycles, instret, events; see perf.c
+  uint64 perfstamp[2+NHPM];    // the counters when it last entered user space
+
+  // shared by a thread group; use tg's.
+  uint64 sz;                   // Size of process memory (bytes)
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
-  char name[16];               // Process name (debugging)
+  struct ring *ring;           // Kernel address of ring page, or 0
+  int ringflags;               // RING_* flags from ringsetup()
+  int ringbusy;                // A thread is taking sqes; p->lock protects
 };
@@ -0,0 +1,16 @@
+// Per-process accounting, as reported by procstat().
+struct procstat {
+  int pid;
+  int ppid;       // parent's pid, or 0
+  int tgid;       // pid of the thread group leader; pid if not a thread
+  int state;      // enum procstate in proc.h
+  int cpu;        // cpu that last ran it
+  char name[16];
+  uint64 utime;   // nanoseconds spent in user space
+  uint64 stime;   // nanoseconds spent running in the kernel
+  uint64 nvcsw;   // voluntary context switches: it slept
+  uint64 nivcsw;  // involuntary context switches: it was preempted
+  uint64 nfaults; // page faults
+  uint64 rss;     // resident user pages
+  uint64 sz;      // size of user memory, in bytes
+};
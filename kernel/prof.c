@@ -0,0 +1,189 @@
+//
+// Sampling profiler.
+//
+// profctl(hz) arms a one-shot timer on every hart, which re-arms
+// itself each time it fires. Each firing records where the hart
+// was interrupted, and a call chain found by following saved frame
+// pointers (we build with -fno-omit-frame-pointer), into that
+// hart's sample buffer. profread() drains the buffers.
+//
+// Chains are best effort: a leaf function may not have saved its
+// return address, and so its caller is missed.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "timer.h"
+#include "prof.h"
+#include "defs.h"
+
+#define NPROFSAMPLE 256  // samples buffered per hart
+
+struct profbuf {
+  struct spinlock lock;
+  struct timer t;        // this hart's sampling timer
+  uint head;             // samples recorded
+  uint tail;             // samples read by profread()
+  uint dropped;          // samples lost to a full buffer
+  struct profsample s[NPROFSAMPLE];
+} profbufs[NCPU];
+
+uint64 profperiod;  // mtime units between samples, or 0 if off
+
+void
+profinit(void)
+{
+  struct profbuf *b;
+
+  for(b = profbufs; b < &profbufs[NCPU]; b++)
+    initlock(&b->lock, "prof");
+}
+
+// Fill in s for the code this hart's timer interrupt interrupted.
+static void
+profrecord(struct profsample *s)
+{
+  struct proc *p = myproc();
+  uint64 fp, base, frame[2];
+
+  s->pid = p ? p->pid : 0;
+  s->hart = cpuid();
+  s->kernel = (r_sstatus() & SSTATUS_SPP) != 0;
+  s->pc = r_sepc();
+  s->depth = 0;
+  if(p)
+    safestrcpy(s->name, p->name, sizeof(s->name));
+  else
+    s->name[0] = 0;
+
+  // a frame keeps the return address at fp-8 and the caller's
+  // fp at fp-16. callers' frames are at higher addresses.
+  if(s->kernel){
+    // kernel stacks are a page; don't wander off this one.
+    fp = mycpu()->trapfp;
+    base = PGROUNDDOWN(fp);
+    while(s->depth < PROFDEPTH && fp % 8 == 0 && fp - 16 >= base && fp <= base + PGSIZE){
+      s->chain[s->depth++] = *(uint64*)(fp - 8);
+      if(*(uint64*)(fp - 16) <= fp)
+        break;
+      fp = *(uint64*)(fp - 16);
+    }
+  } else {
+    fp = p->trapframe->s0;
+    while(s->depth < PROFDEPTH && fp % 8 == 0 && fp >= 16 &&
+          copyin(p->pagetable, (char*)frame, fp - 16, sizeof(frame)) == 0){
+      s->chain[s->depth++] = frame[1];
+      if(frame[0] <= fp)
+        break;
+      fp = frame[0];
+    }
+  }
+}
+
+// This hart's sampling timer.
+static void
+proftick(struct timer *t)
+{
+  struct profbuf *b = &profbufs[cpuid()];
+  uint64 now;
+
+  if(profperiod == 0)
+    return;
+
+  acquire(&b->lock);
+  if(b->head - b->tail < NPROFSAMPLE){
+    profrecord(&b->s[b->head % NPROFSAMPLE]);
+    b->head++;
+  } else {
+    b->dropped++;
+  }
+  release(&b->lock);
+
+  now = r_time();
+  t->deadline += profperiod;
+  if(t->deadline <= now)
+    t->deadline = now + profperiod;
+  timer_add(t);
+}
+
+// Start this hart's sampling timer, if profiling is on and the
+// timer is not already running. Interrupts must be off, so that
+// the timer can't fire on this hart meanwhile.
+void
+profarm(void)
+{
+  struct timer *t = &profbufs[cpuid()].t;
+
+  if(profperiod == 0 || t->pending)
+    return;
+  t->deadline = r_time() + profperiod;
+  t->fn = proftick;
+  timer_add(t);
+}
+
+// Sample every hart hz times a second, emptying the buffers
+// first, or stop if hz is 0. Returns how many samples were
+// dropped since the last call, or -1 if hz is out of range.
+int
+profctl(int hz)
+{
+  struct profbuf *b;
+  struct cpu *c;
+  int dropped = 0;
+
+  if(hz < 0 || hz > PROFMAXHZ)
+    return -1;
+
+  // each timer sees profperiod 0 and doesn't re-arm.
+  profperiod = 0;
+  for(b = profbufs; b < &profbufs[NCPU]; b++){
+    acquire(&b->lock);
+    dropped += b->dropped;
+    b->dropped = 0;
+    if(hz)
+      b->head = b->tail = 0;
+    release(&b->lock);
+  }
+  if(hz == 0)
+    return dropped;
+
+  profperiod = MTIME_FREQ / hz;
+  __sync_synchronize();
+  push_off();
+  profarm();
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c != mycpu() && c->online)
+      ipisend(c, IPI_PROF);
+  pop_off();
+  return dropped;
+}
+
+// Copy up to n buffered samples, oldest first on each hart, to
+// user address addr, and forget them. Returns how many.
+int
+profread(uint64 addr, int n)
+{
+  struct profbuf *b;
+  struct profsample s;
+  int i = 0;
+
+  for(b = profbufs; b < &profbufs[NCPU] && i < n; b++){
+    while(i < n){
+      acquire(&b->lock);
+      if(b->tail == b->head){
+        release(&b->lock);
+        break;
+      }
+      s = b->s[b->tail++ % NPROFSAMPLE];
+      release(&b->lock);
+      if(copyout(myproc()->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+        return -1;
+      i++;
+    }
+  }
+  return i;
+}
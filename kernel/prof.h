@@ -0,0 +1,14 @@
+// Samples from the profiler; see profctl() and profread().
+#define PROFDEPTH  8      // return addresses kept per sample
+#define PROFMAXHZ  10000  // fastest sampling rate profctl() allows
+
+struct profsample {
+  int pid;                 // 0 if the hart was idle
+  uchar hart;
+  uchar kernel;            // 1 if pc is in the kernel, 0 if in user space
+  uchar depth;             // how many of chain[] are valid
+  uchar pad;
+  char name[16];           // process name, which names its .sym file
+  uint64 pc;               // where the hart was interrupted
+  uint64 chain[PROFDEPTH]; // return addresses, innermost first
+};
@@ -0,0 +1,163 @@
+//
+// System call rings.
+//
+// A process that calls ringsetup() gets a page mapped at RINGPAGE
+// holding a submission ring and a completion ring; see ring.h.
+// ringenter() performs every queued submission with one trap,
+// and with RING_SQPOLL the kernel also drains the ring whenever
+// the clock interrupts the process, so that it need not trap at
+// all. Either way the work is done in the process's own context,
+// so an operation may sleep just as the system call would.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "ring.h"
+#include "defs.h"
+
+// Give the calling process its rings.
+// Returns their user address, or -1.
+uint64
+ringsetup(int flags)
+{
+  struct proc *p = myproc()->tg;
+  char *mem;
+
+  if((flags & ~RING_SQPOLL) != 0)
+    return -1;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  ((struct ring*)mem)->flags = flags;
+
+  acquire(&p->lock);
+  if(p->ring != 0 ||
+     mappages(p->pagetable, RINGPAGE, PGSIZE, (uint64)mem, PTE_R | PTE_W | PTE_U) < 0){
+    release(&p->lock);
+    kfree(mem);
+    return -1;
+  }
+  p->ring = (struct ring*)mem;
+  p->ringflags = flags;
+  release(&p->lock);
+  return RINGPAGE;
+}
+
+// Unmap and free p's rings, if it has them. For exec()
+// and freeproc(), when no other thread can be using them.
+void
+ringfree(struct proc *p)
+{
+  if(p->ring == 0)
+    return;
+  uvmunmap(p->pagetable, RINGPAGE, 1, 1);
+  p->ring = 0;
+  p->ringflags = 0;
+}
+
+// Perform one submission, and return its result.
+static uint64
+ringop(struct sqe *e)
+{
+  struct file *f;
+  int r;
+
+  switch(e->op){
+  case RING_NOP:
+    return 0;
+  case RING_READ:
+  case RING_WRITE:
+    // another thread may close fd while we sleep.
+    if((f = fdget(e->fd)) == 0)
+      return -1;
+    if(e->op == RING_READ)
+      r = fileread(f, e->addr, e->len);
+    else
+      r = filewrite(f, e->addr, e->len);
+    fileclose(f);
+    return r;
+  case RING_GPUCMD:
+    return gpucmd(e->len);
+  case RING_KBD:
+    return kbdcmd();
+  }
+  return -1;
+}
+
+// Take up to max submissions from p's ring, all of them if max
+// is negative, stopping early if the completion ring fills.
+// Returns how many were performed. The ring is in user memory,
+// so the process may scribble on it at any time; indexes are
+// only ever used modulo NRING, and each sqe is copied once.
+static int
+ringdrain(struct proc *p, int max)
+{
+  struct ring *r = p->ring;
+  struct cqe *c;
+  struct sqe e;
+  uint head;
+  int n;
+
+  // only one thread of a group at a time.
+  acquire(&p->lock);
+  if(p->ringbusy){
+    release(&p->lock);
+    return 0;
+  }
+  p->ringbusy = 1;
+  release(&p->lock);
+
+  head = r->sqhead;
+  for(n = 0; n != max; n++){
+    __sync_synchronize();
+    if(head == r->sqtail || r->cqtail - r->cqhead >= NRING)
+      break;
+    e = r->sq[head % NRING];
+    r->sqhead = ++head;
+
+    c = &r->cq[r->cqtail % NRING];
+    c->data = e.data;
+    c->res = ringop(&e);
+    __sync_synchronize();
+    r->cqtail++;
+  }
+
+  acquire(&p->lock);
+  p->ringbusy = 0;
+  release(&p->lock);
+  return n;
+}
+
+// Perform up to n queued submissions, or all of them if n
+// is 0. Returns how many, or -1 if there are no rings.
+int
+ringenter(int n)
+{
+  struct proc *p = myproc()->tg;
+
+  if(p->ring == 0 || n < 0)
+    return -1;
+  return ringdrain(p, n == 0 ? -1 : n);
+}
+
+// Called by usertrap() on a clock interrupt, with interrupts
+// off. The submissions may sleep, on disk or pipes, and may need
+// a TLB shootdown answered, so turn them on as a system call
+// does; usertrap() has already saved sepc.
+void
+ringpoll(void)
+{
+  struct proc *p = myproc()->tg;
+
+  if(p->ring && (p->ringflags & RING_SQPOLL)){
+    intr_on();
+    ringdrain(p, -1);
+  }
+}
@@ -0,0 +1,42 @@
+// Submission and completion rings, shared between a process
+// and the kernel, for making system calls without traps.
+// The process queues sqes and advances sqtail; the kernel
+// takes them from sqhead, performs them in order, and posts a
+// cqe for each at cqtail, which the process consumes from cqhead.
+
+// operations, for sqe.op.
+#define RING_NOP     0  // res = 0
+#define RING_READ    1  // res = read(fd, addr, len)
+#define RING_WRITE   2  // res = write(fd, addr, len)
+#define RING_GPUCMD  3  // res = gpucmd(len)
+#define RING_KBD     4  // res = kbdcmd()
+
+// ringsetup() flags.
+#define RING_SQPOLL  1  // the kernel also takes sqes at each clock tick
+
+#define NRING 64  // entries in each ring; a power of two
+
+struct sqe {
+  int op;       // RING_*
+  int fd;
+  uint64 addr;
+  int len;
+  int pad;
+  uint64 data;  // for the caller; copied to the cqe
+};
+
+struct cqe {
+  uint64 data;  // from the sqe
+  uint64 res;   // what the system call would have returned
+};
+
+struct ring {
+  uint sqhead;  // written by the kernel
+  uint sqtail;  // written by the process
+  uint cqhead;  // written by the process
+  uint cqtail;  // written by the kernel
+  uint sqnext;  // user library's next sqe; the kernel ignores it
+  uint flags;   // as given to ringsetup()
+  struct sqe sq[NRING];
+  struct cqe cq[NRING];
+};
@@ -183,6 +183,27 @@ w_mtvec(uint64 x)
   asm volatile("csrw mtvec, %0" : : "r" (x));
 }
 
+static inline uint64
+r_mtvec()
+{
+  uint64 x;
+  asm volatile("csrr %0, mtvec" : "=r" (x) );
+  return x;
+}
+
+// Machine Environment Configuration (0x30a), from the
+// privileged spec 1.12; older cpus don't have it.
+#define MENVCFG_STCE (1L << 63) // supervisor may use stimecmp (Sstc)
+
+// Supervisor Timer Compare (0x14d), from the Sstc extension.
+// the supervisor timer interrupt is pending while
+// time >= stimecmp.
+static inline void 
+w_stimecmp(uint64 x)
+{
+  asm volatile("csrw 0x14d, %0" : : "r" (x));
+}
+
 // Physical Memory Protection
 static inline void
 w_pmpcfg0(uint64 x)
@@ -242,6 +263,10 @@ r_stval()
 }
 
 // Machine-mode Counter-Enable
+#define MCOUNTEREN_CY (1L << 0) // lower modes may read the cycle CSR
+#define MCOUNTEREN_TM (1L << 1) // lower modes may read the time CSR
+#define MCOUNTEREN_IR (1L << 2) // lower modes may read the instret CSR
+#define MCOUNTEREN_HPM(i) (1L << (3+(i))) // ... and hpmcounter3+i
 static inline void 
 w_mcounteren(uint64 x)
 {
@@ -256,7 +281,44 @@ r_mcounteren()
   return x;
 }
 
-// machine-mode cycle counter
+// Supervisor-mode Counter-Enable
+#define SCOUNTEREN_CY (1L << 0) // user mode may read the cycle CSR
+#define SCOUNTEREN_TM (1L << 1) // user mode may read the time CSR
+#define SCOUNTEREN_IR (1L << 2) // user mode may read the instret CSR
+#define SCOUNTEREN_HPM(i) (1L << (3+(i))) // ... and hpmcounter3+i
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+// cycles this hart has run.
+static inline uint64
+r_cycle()
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x) );
+  return x;
+}
+
+// instructions this hart has retired.
+static inline uint64
+r_instret()
+{
+  uint64 x;
+  asm volatile("csrr %0, instret" : "=r" (x) );
+  return x;
+}
+
+// mtime, as seen through the time CSR.
 static inline uint64
 r_time()
 {
@@ -279,6 +341,14 @@ intr_off()
   w_sstatus(r_sstatus() & ~SSTATUS_SIE);
 }
 
+// wait for an interrupt. returns once one is pending
+// in sie, even if interrupts are off in sstatus.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // are device interrupts enabled?
 static inline int
 intr_get()
@@ -319,6 +389,15 @@ r_ra()
   return x;
 }
 
+// read the frame pointer.
+static inline uint64
+r_fp()
+{
+  uint64 x;
+  asm volatile("mv %0, s0" : "=r" (x) );
+  return x;
+}
+
 // flush the TLB.
 static inline void
 sfence_vma()
@@ -0,0 +1,5 @@
+// Scheduling policies, for setsched().
+#define SCHED_NORMAL  0   // round robin, preempted at every clock tick
+#define SCHED_FIFO    1   // real-time: runs until it blocks, or until a
+                          // higher-priority SCHED_FIFO process is runnable
+#define SCHED_MAXPRIO 99  // SCHED_FIFO priorities are 1..SCHED_MAXPRIO
@@ -6,14 +6,54 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "proc.h"
+#include "lockstat.h"
 #include "defs.h"
 
+#ifdef LOCKSTAT
+#define NLOCKSTAT 64  // distinct lock names with statistics
+
+struct {
+  uint locked;        // a plain test-and-set lock; spinlocks use the table.
+  int n;
+  struct lockstat stat[NLOCKSTAT];
+} lockstats;
+
+// Find or make the statistics entry for locks named name.
+// Returns 0 if the table is full.
+static struct lockstat*
+lockstatfor(char *name)
+{
+  struct lockstat *ls;
+
+  while(__sync_lock_test_and_set(&lockstats.locked, 1) != 0)
+    ;
+  __sync_synchronize();
+  for(ls = lockstats.stat; ls < &lockstats.stat[lockstats.n]; ls++)
+    if(strncmp(ls->name, name, sizeof(ls->name)-1) == 0)
+      break;
+  if(ls == &lockstats.stat[lockstats.n]){
+    if(lockstats.n < NLOCKSTAT){
+      lockstats.n++;
+      safestrcpy(ls->name, name, sizeof(ls->name));
+    } else {
+      ls = 0;
+    }
+  }
+  __sync_lock_release(&lockstats.locked);
+  return ls;
+}
+#endif
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+#ifdef LOCKSTAT
+  lk->stat = lockstatfor(name);
+#endif
 }
 
 // Acquire the lock.
@@ -25,13 +65,35 @@ acquire(struct spinlock *lk)
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  // Take a ticket. On RISC-V, sync_fetch_and_add turns into
+  // an atomic add:
   //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+  //   s1 = &lk->next
+  //   amoadd.w.aqrl a5, a5, (s1)
+  uint ticket = __sync_fetch_and_add(&lk->next, 1);
+
+#ifdef LOCKSTAT
+  uint64 t0 = 0;
+  int contended = *(volatile uint*)&lk->owner != ticket;
+  if(contended)
+    t0 = r_cycle();
+#endif
+
+  // Wait for our turn. Only the holder writes owner, so
+  // waiters just read it, and share its cache line.
+  while(*(volatile uint*)&lk->owner != ticket)
     ;
 
+#ifdef LOCKSTAT
+  if(lk->stat){
+    __sync_fetch_and_add(&lk->stat->nacquire, 1);
+    if(contended){
+      __sync_fetch_and_add(&lk->stat->ncontended, 1);
+      __sync_fetch_and_add(&lk->stat->spincycles, r_cycle() - t0);
+    }
+  }
+#endif
+
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
   // references happen strictly after the lock is acquired.
@@ -59,14 +121,10 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // Release the lock by passing it to the next ticket.
+  // Only the holder writes owner, and a uint store is a
+  // single sw instruction, so this needs no atomic.
+  *(volatile uint*)&lk->owner = lk->owner + 1;
 
   pop_off();
 }
@@ -77,7 +135,7 @@ int
 holding(struct spinlock *lk)
 {
   int r;
-  r = (lk->locked && lk->cpu == mycpu());
+  r = (lk->next != lk->owner && lk->cpu == mycpu());
   return r;
 }
 
@@ -108,3 +166,23 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Copy out statistics for up to n lock names, as struct
+// lockstats, to user address addr. Returns how many were
+// copied, or -1 if the kernel was built without LOCKSTAT.
+int
+lockstat(uint64 addr, int n)
+{
+#ifdef LOCKSTAT
+  int i;
+
+  for(i = 0; i < n && i < lockstats.n; i++){
+    if(copyout(myproc()->pagetable, addr + i*sizeof(struct lockstat),
+               (char*)&lockstats.stat[i], sizeof(struct lockstat)) < 0)
+      return -1;
+  }
+  return i;
+#else
+  return -1;
+#endif
+}
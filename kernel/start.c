@@ -13,28 +13,33 @@ __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 // a scratch area per CPU for machine-mode timer interrupts.
 uint64 timer_scratch[NCPU][5];
 
-// assembly code in kernelvec.S for machine-mode timer interrupt.
+// assembly code in kernelvec.S for machine-mode timer
+// and software interrupts.
 extern void timervec();
 
+// in kernelvec.S, for sstcprobe().
+extern void mtrapskip();
+
+// does each hart have the Sstc extension, so that supervisor
+// mode can program its own timer with stimecmp?
+int sstc[NCPU];
+
+// how many of hpmcounter3 and up, to NHPM, each hart has.
+int nhpm[NCPU];
+
+static int hpmprobe(void);
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
 {
-  // set M Previous Privilege mode to Supervisor, for mret.
-  unsigned long x = r_mstatus();
-  x &= ~MSTATUS_MPP_MASK;
-  x |= MSTATUS_MPP_S;
-  w_mstatus(x);
-
-  // set M Exception Program Counter to main, for mret.
-  // requires gcc -mcmodel=medany
-  w_mepc((uint64)main);
-
   // disable paging for now.
   w_satp(0);
 
-  // delegate all interrupts and exceptions to supervisor mode.
-  w_medeleg(0xffff);
+  // delegate all interrupts and exceptions to supervisor mode,
+  // except ecalls from supervisor mode, which ask machine mode
+  // to program the event counters; see hpmecall in kernelvec.S.
+  w_medeleg(0xffff & ~(1L << 9));
   w_mideleg(0xffff);
   w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
@@ -43,6 +48,14 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read mtime through the time CSR, its
+  // cycle and instruction counts through the cycle and instret
+  // CSRs, and whichever event counters there are; see perf.c.
+  w_mcounteren(r_mcounteren() | MCOUNTEREN_TM | MCOUNTEREN_CY | MCOUNTEREN_IR);
+  nhpm[r_mhartid()] = hpmprobe();
+  for(int i = 0; i < nhpm[r_mhartid()]; i++)
+    w_mcounteren(r_mcounteren() | MCOUNTEREN_HPM(i));
+
   // ask for clock interrupts.
   timerinit();
 
@@ -50,32 +63,104 @@ start()
   int id = r_mhartid();
   w_tp(id);
 
+  // set M Previous Privilege mode to Supervisor, for mret.
+  // this and mepc come after the probes above: one that
+  // traps to mtrapskip leaves both pointing back at itself.
+  unsigned long x = r_mstatus();
+  x &= ~MSTATUS_MPP_MASK;
+  x |= MSTATUS_MPP_S;
+  w_mstatus(x);
+
+  // set M Exception Program Counter to main, for mret.
+  // requires gcc -mcmodel=medany
+  w_mepc((uint64)main);
+
   // switch to supervisor mode and jump to main().
   asm volatile("mret");
 }
 
+// turn on Sstc for supervisor mode, if this hart has it, by
+// setting menvcfg.STCE and reading it back. without it, the
+// bit reads as zero; without menvcfg at all, the csr
+// instructions trap to mtrapskip, leaving x zero.
+static int
+sstcprobe(void)
+{
+  uint64 x = 0;
+  uint64 mtvec = r_mtvec();
+
+  w_mtvec((uint64)mtrapskip);
+  asm volatile("csrs 0x30a, %1\n\tcsrr %0, 0x30a"
+               : "+r" (x) : "r" (MENVCFG_STCE) : "t0");
+  w_mtvec(mtvec);
+  return (x & MENVCFG_STCE) != 0;
+}
+
+// does this hart have mhpmcounter n? one that is missing traps
+// to mtrapskip, and one that isn't implemented reads as zero.
+// counts nothing until perfctl() picks an event for it.
+#define HPMPROBE(n) ({ \
+  uint64 x = 0; \
+  asm volatile("csrw mhpmevent" #n ", zero\n\t" \
+               "csrw mhpmcounter" #n ", %1\n\t" \
+               "csrr %0, mhpmcounter" #n "\n\t" \
+               "csrw mhpmcounter" #n ", zero" \
+               : "+r" (x) : "r" (1L) : "t0"); \
+  x != 0; \
+})
+
+// how many event counters, from hpmcounter3, does this hart
+// have, up to NHPM (4)? like sstcprobe(), this must run before
+// start() points mepc at main(). make bootcheck boots a hart
+// with none of them, and no menvcfg.
+static int
+hpmprobe(void)
+{
+  uint64 mtvec = r_mtvec();
+  int n = 0;
+
+  w_mtvec((uint64)mtrapskip);
+  if(HPMPROBE(3)){
+    n++;
+    if(HPMPROBE(4)){
+      n++;
+      if(HPMPROBE(5)){
+        n++;
+        if(HPMPROBE(6))
+          n++;
+      }
+    }
+  }
+  w_mtvec(mtvec);
+  return n;
+}
+
 // arrange to receive timer interrupts.
 // they will arrive in machine mode at
 // at timervec in kernelvec.S,
 // which turns them into software interrupts for
-// devintr() in trap.c.
+// devintr() in trap.c. supervisor mode decides
+// when each one happens; see timer.c. with Sstc,
+// supervisor mode gets its own timer interrupts
+// instead, and only IPIs come through timervec.
 void
 timerinit()
 {
   // each CPU has a separate source of timer interrupts.
   int id = r_mhartid();
 
-  // ask the CLINT for a timer interrupt.
-  int interval = 300000; // cycles; about 1/100th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  // no timer interrupt until clockinithart() asks for one.
+  *(uint64*)CLINT_MTIMECMP(id) = -1;
+
+  sstc[id] = sstcprobe();
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[4] : address of CLINT MSIP register.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  scratch[4] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -84,6 +169,10 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode software interrupts for IPIs from
+  // other harts, see ipi.c, and timer interrupts unless
+  // supervisor mode has stimecmp.
+  w_mie(r_mie() | MIE_MSIE);
+  if(!sstc[id])
+    w_mie(r_mie() | MIE_MTIE);
 }
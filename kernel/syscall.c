@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "trace.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -12,7 +13,8 @@ int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz) // both tests needed, in case of overflow
+  uint64 sz = p->tg->sz;
+  if(addr >= sz || addr+sizeof(uint64) > sz) // both tests needed, in case of overflow
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -103,6 +105,28 @@ extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_gpucmd(void);
 extern uint64 sys_kbdcmd(void);
+extern uint64 sys_setsched(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_nanotime(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_irqaffinity(void);
+extern uint64 sys_irqstat(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_pipe2(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_futex(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_ringsetup(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_procstat(void);
+extern uint64 sys_profctl(void);
+extern uint64 sys_profread(void);
+extern uint64 sys_perfctl(void);
+extern uint64 sys_perfread(void);
+extern uint64 sys_tracectl(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_lseek(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -130,6 +154,28 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_gpucmd]  sys_gpucmd,
 [SYS_kbdcmd]  sys_kbdcmd,
+[SYS_setsched] sys_setsched,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_nanotime] sys_nanotime,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_irqaffinity] sys_irqaffinity,
+[SYS_irqstat] sys_irqstat,
+[SYS_lockstat] sys_lockstat,
+[SYS_pipe2] sys_pipe2,
+[SYS_clone] sys_clone,
+[SYS_futex] sys_futex,
+[SYS_poll]  sys_poll,
+[SYS_ringsetup] sys_ringsetup,
+[SYS_ringenter] sys_ringenter,
+[SYS_procstat] sys_procstat,
+[SYS_profctl]  sys_profctl,
+[SYS_profread] sys_profread,
+[SYS_perfctl]  sys_perfctl,
+[SYS_perfread] sys_perfread,
+[SYS_tracectl] sys_tracectl,
+[SYS_traceread] sys_traceread,
+[SYS_sysstat] sys_sysstat,
+[SYS_lseek]   sys_lseek,
 };
 
 void
@@ -137,8 +183,11 @@ syscall(void)
 {
   int num;
   struct proc *p = myproc();
+  uint64 t0 = r_time();
 
   num = p->trapframe->a7;
+  if(tracemask & TRACE_SYSCALL)
+    trace(TR_SYSCALL, num, 0);
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
@@ -148,4 +197,7 @@ syscall(void)
             p->pid, p->name, num);
     p->trapframe->a0 = -1;
   }
+  statsyscall(num, t0);
+  if(tracemask & TRACE_SYSCALL)
+    trace(TR_SYSRET, p->trapframe->a0, num);
 }
@@ -21,4 +21,26 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_gpucmd 22
-#define SYS_kbdcmd 23
\ No newline at end of file
+#define SYS_kbdcmd 23
+#define SYS_setsched 24
+#define SYS_setaffinity 25
+#define SYS_nanotime 26
+#define SYS_nanosleep 27
+#define SYS_irqaffinity 28
+#define SYS_irqstat 29
+#define SYS_lockstat 30
+#define SYS_pipe2 31
+#define SYS_clone 32
+#define SYS_futex 33
+#define SYS_poll  34
+#define SYS_ringsetup 35
+#define SYS_ringenter 36
+#define SYS_procstat 37
+#define SYS_profctl  38
+#define SYS_profread 39
+#define SYS_perfctl  40
+#define SYS_perfread 41
+#define SYS_tracectl 42
+#define SYS_traceread 43
+#define SYS_sysstat 44
+#define SYS_lseek 45
\ No newline at end of file
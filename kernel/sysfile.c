@@ -17,20 +17,16 @@
 #include "fcntl.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return the corresponding struct file, with a reference held
+// that the caller must drop with fileclose().
 static int
-argfd(int n, int *pfd, struct file **pf)
+argfd(int n, struct file **pf)
 {
   int fd;
-  struct file *f;
 
   argint(n, &fd);
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((*pf = fdget(fd)) == 0)
     return -1;
-  if(pfd)
-    *pfd = fd;
-  if(pf)
-    *pf = f;
   return 0;
 }
 
@@ -40,14 +36,18 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *p = myproc()->tg;
 
+  // the group's threads may be opening files at once.
+  acquire(&p->lock);
   for(fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd] == 0){
       p->ofile[fd] = f;
+      release(&p->lock);
       return fd;
     }
   }
+  release(&p->lock);
   return -1;
 }
 
@@ -57,11 +57,13 @@ sys_dup(void)
   struct file *f;
   int fd;
 
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  // the new fd takes over argfd's reference.
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -69,29 +71,33 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
   argaddr(1, &p);
   argint(2, &n);
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
   
   argaddr(1, &p);
   argint(2, &n);
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, &f) < 0)
     return -1;
 
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
@@ -99,10 +105,20 @@ sys_close(void)
 {
   int fd;
   struct file *f;
+  struct proc *p = myproc()->tg;
 
-  if(argfd(0, &fd, &f) < 0)
+  argint(0, &fd);
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  // two threads may close fd at once; only the
+  // one that empties the slot drops its reference.
+  acquire(&p->lock);
+  if((f = p->ofile[fd]) == 0){
+    release(&p->lock);
     return -1;
-  myproc()->ofile[fd] = 0;
+  }
+  p->ofile[fd] = 0;
+  release(&p->lock);
   fileclose(f);
   return 0;
 }
@@ -112,11 +128,29 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
   argaddr(1, &st);
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, &f) < 0)
+    return -1;
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence, r;
+
+  argint(1, &off);
+  argint(2, &whence);
+  if(argfd(0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filelseek(f, off, whence);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -410,8 +444,8 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
-  struct proc *p = myproc();
+  struct inode *ip, *old;
+  struct proc *p = myproc()->tg;
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
@@ -425,9 +459,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
-  end_op();
+  acquire(&p->lock);
+  old = p->cwd;
   p->cwd = ip;
+  release(&p->lock);
+  iput(old);
+  end_op();
   return 0;
 }
 
@@ -474,16 +511,16 @@ sys_exec(void)
   return -1;
 }
 
-uint64
-sys_pipe(void)
+// make a pipe whose buffer holds at least size bytes,
+// or the default if size is 0.
+static int
+mkpipe(uint64 fdarray, int size)
 {
-  uint64 fdarray; // user pointer to array of two integers
   struct file *rf, *wf;
   int fd0, fd1;
-  struct proc *p = myproc();
+  struct proc *p = myproc()->tg;
 
-  argaddr(0, &fdarray);
-  if(pipealloc(&rf, &wf) < 0)
+  if(pipealloc(&rf, &wf, size) < 0)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
@@ -503,3 +540,54 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_pipe(void)
+{
+  uint64 fdarray; // user pointer to array of two integers
+
+  argaddr(0, &fdarray);
+  return mkpipe(fdarray, 0);
+}
+
+uint64
+sys_pipe2(void)
+{
+  uint64 fdarray;
+  int size;
+
+  argaddr(0, &fdarray);
+  argint(1, &size);
+  return mkpipe(fdarray, size);
+}
+
+// wait for any of an array of pollfds; see poll.c.
+uint64
+sys_poll(void)
+{
+  uint64 fds, timeout;
+  int n;
+
+  argaddr(0, &fds);
+  argint(1, &n);
+  argaddr(2, &timeout);
+  return poll(fds, n, timeout);
+}
+
+uint64
+sys_ringsetup(void)
+{
+  int flags;
+
+  argint(0, &flags);
+  return ringsetup(flags);
+}
+
+uint64
+sys_ringenter(void)
+{
+  int n;
+
+  argint(0, &n);
+  return ringenter(n);
+}
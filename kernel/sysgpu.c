@@ -20,6 +20,11 @@ extern uint32 * framebuffer;
 uint64 sys_gpucmd(void) {
 	int callno = 0; // call number userspace gave us
 	argint(0,&callno); // read into call number
+	return gpucmd(callno);
+}
+
+// Perform gpu call callno for the current process; also used by ring.c
+uint64 gpucmd(int callno) {
 	switch (callno) {
 		case 0:
 			// Call 0 - transfer and flush framebuffer
@@ -51,6 +56,7 @@ uint64 sys_gpucmd(void) {
 			{
 				struct proc * this_proc = myproc();
 				uvmunmap(this_proc->pagetable,FRAMEBUFFER,64,0);
+				tlbshootdown(this_proc->pagetable);
 				printf("Mapping unmapped\n");
 				release_fb();
 				return (uint64) 0;
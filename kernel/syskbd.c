@@ -11,6 +11,12 @@
 extern struct virtio_input_event ring_buffer_advance(void);
 
 uint64 sys_kbdcmd(void){
+	return kbdcmd();
+}
+
+// Pop the oldest key event, packed as type<<48 | code<<32 | value,
+// or 0 if there is none; also used by ring.c
+uint64 kbdcmd(void){
 	struct virtio_input_event input_event = ring_buffer_advance();
 	uint64 return_event = 0;
 	return_event = return_event | ((uint64) input_event.type) << 48;
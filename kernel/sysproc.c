@@ -42,8 +42,7 @@ sys_sbrk(void)
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if((addr = growproc(n)) == -1)
     return -1;
   return addr;
 }
@@ -52,20 +51,11 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  return nanosleep((uint64)n * TICKNS);
 }
 
 uint64
@@ -77,15 +67,183 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
+// return how many clock ticks have passed since start.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return uptime();
+}
+
+uint64
+sys_setsched(void)
+{
+  int pid, policy, prio;
+
+  argint(0, &pid);
+  argint(1, &policy);
+  argint(2, &prio);
+  return setsched(pid, policy, prio);
+}
+
+uint64
+sys_setaffinity(void)
+{
+  int pid;
+  uint64 mask;
+
+  argint(0, &pid);
+  argaddr(1, &mask);
+  return setaffinity(pid, mask);
+}
+
+// return nanoseconds since boot, from mtime.
+uint64
+sys_nanotime(void)
+{
+  return nanotime();
+}
+
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  argaddr(0, &ns);
+  return nanosleep(ns);
+}
+
+uint64
+sys_irqaffinity(void)
+{
+  int irq;
+  uint64 mask;
+
+  argint(0, &irq);
+  argaddr(1, &mask);
+  return irqaffinity(irq, mask);
+}
+
+uint64
+sys_irqstat(void)
+{
+  int irq;
+  uint64 addr;
+
+  argint(0, &irq);
+  argaddr(1, &addr);
+  return irqstat(irq, addr);
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return lockstat(addr, n);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_futex(void)
+{
+  uint64 addr;
+  int op, val;
+
+  argaddr(0, &addr);
+  argint(1, &op);
+  argint(2, &val);
+  return futex(addr, op, val);
+}
+
+uint64
+sys_procstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return procstat(addr, n);
+}
+
+uint64
+sys_profctl(void)
+{
+  int hz;
+
+  argint(0, &hz);
+  return profctl(hz);
+}
+
+uint64
+sys_profread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return profread(addr, n);
+}
+
+uint64
+sys_perfctl(void)
+{
+  int i;
+  uint64 event;
+
+  argint(0, &i);
+  argaddr(1, &event);
+  return perfctl(i, event);
+}
+
+uint64
+sys_perfread(void)
+{
+  uint64 addr;
+
+  argaddr(0, &addr);
+  return perfread(addr);
+}
+
+uint64
+sys_tracectl(void)
+{
+  int mask;
+
+  argint(0, &mask);
+  return tracectl(mask);
+}
+
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return traceread(addr, n);
+}
+
+uint64
+sys_sysstat(void)
+{
+  uint64 addr;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  argaddr(0, &addr);
+  return sysstat(addr);
 }
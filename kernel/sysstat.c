@@ -0,0 +1,126 @@
+//
+// System-wide system call, interrupt and idle accounting.
+//
+// Each hart counts in its own hartstats entry, with interrupts
+// off, so no locks are needed. Times are kept in mtime units
+// and turned into nanoseconds by sysstat(), which adds up the
+// harts' counts.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "timer.h"
+#include "sysstat.h"
+#include "defs.h"
+
+static struct {
+  struct sysstatcall sys[NSYSCALL];
+  struct sysstatirq irq[NIRQ];
+  struct sysstathart hart;
+} hartstats[NCPU];
+
+// which histogram bucket a call of t mtime units goes in.
+static int
+latbucket(uint64 t)
+{
+  uint64 us = t * NSPERMTIME / 1000;
+  int b;
+
+  for(b = 0; us && b < NLATBUCKET-1; us >>= 1)
+    b++;
+  return b;
+}
+
+// count system call num, which started at mtime t0.
+void
+statsyscall(int num, uint64 t0)
+{
+  struct sysstatcall *s;
+  uint64 t;
+
+  if(num <= 0 || num >= NSYSCALL)
+    return;
+  push_off();
+  t = r_time() - t0;
+  s = &hartstats[cpuid()].sys[num];
+  s->count++;
+  s->ns += t;
+  s->hist[latbucket(t)]++;
+  pop_off();
+}
+
+// count an interrupt from irq, whose handler started at mtime t0.
+// interrupts are off.
+void
+statirq(int irq, uint64 t0)
+{
+  struct sysstatirq *s;
+
+  if(irq < 0 || irq >= NIRQ)
+    return;
+  s = &hartstats[cpuid()].irq[irq];
+  s->count++;
+  s->ns += r_time() - t0;
+}
+
+// count a clock tick. interrupts are off.
+void
+stattick(void)
+{
+  hartstats[cpuid()].hart.ticks++;
+}
+
+// count time spent idle since mtime t0. interrupts are off.
+void
+statidle(uint64 t0)
+{
+  hartstats[cpuid()].hart.idlens += r_time() - t0;
+}
+
+// Copy the counts, summed over harts, to user address addr
+// as a struct sysstat.
+int
+sysstat(uint64 addr)
+{
+  pagetable_t pt = myproc()->pagetable;
+  uint64 irqaddr = addr + NSYSCALL*sizeof(struct sysstatcall);
+  uint64 hartaddr = irqaddr + NIRQ*sizeof(struct sysstatirq);
+  struct sysstatcall c;
+  struct sysstatirq q;
+  struct sysstathart h;
+  int i, j, k;
+
+  for(i = 0; i < NSYSCALL; i++){
+    memset(&c, 0, sizeof(c));
+    for(k = 0; k < NCPU; k++){
+      c.count += hartstats[k].sys[i].count;
+      c.ns += hartstats[k].sys[i].ns;
+      for(j = 0; j < NLATBUCKET; j++)
+        c.hist[j] += hartstats[k].sys[i].hist[j];
+    }
+    c.ns *= NSPERMTIME;
+    if(copyout(pt, addr + i*sizeof(c), (char*)&c, sizeof(c)) < 0)
+      return -1;
+  }
+  for(i = 0; i < NIRQ; i++){
+    memset(&q, 0, sizeof(q));
+    for(k = 0; k < NCPU; k++){
+      q.count += hartstats[k].irq[i].count;
+      q.ns += hartstats[k].irq[i].ns;
+    }
+    q.ns *= NSPERMTIME;
+    if(copyout(pt, irqaddr + i*sizeof(q), (char*)&q, sizeof(q)) < 0)
+      return -1;
+  }
+  for(i = 0; i < NCPU; i++){
+    h = hartstats[i].hart;
+    h.idlens *= NSPERMTIME;
+    if(copyout(pt, hartaddr + i*sizeof(h), (char*)&h, sizeof(h)) < 0)
+      return -1;
+  }
+  return 0;
+}
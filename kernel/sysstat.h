@@ -0,0 +1,27 @@
+// System-wide counters, as reported by sysstat().
+#define NSYSCALL    64  // system call numbers counted
+#define NLATBUCKET  20  // latency histogram buckets
+
+struct sysstatcall {
+  uint64 count;
+  uint64 ns;                // total time spent in the call
+  // calls by how long they took: bucket 0 under 1us, bucket i
+  // from 2^(i-1) to 2^i us, and the last one anything longer.
+  uint64 hist[NLATBUCKET];
+};
+
+struct sysstatirq {
+  uint64 count;
+  uint64 ns;                // total time spent in the handler
+};
+
+struct sysstathart {
+  uint64 ticks;             // clock ticks taken
+  uint64 idlens;            // time spent waiting for an interrupt
+};
+
+struct sysstat {
+  struct sysstatcall sys[NSYSCALL];  // by system call number
+  struct sysstatirq irq[NIRQ];       // by PLIC irq; 0 is the clock and IPIs
+  struct sysstathart hart[NCPU];
+};
@@ -0,0 +1,9 @@
+// The time page: mapped read-only at TIMEPAGE in every process,
+// so user code can turn the time CSR into nanoseconds without
+// a system call. Filled in once at boot; see timer.c.
+struct timepage {
+  uint64 freq;   // mtime cycles per second
+  uint64 base;   // mtime at nanotime() zero
+  uint64 mult;   // nanoseconds = ((mtime - base) * mult) >> shift
+  uint64 shift;
+};
@@ -0,0 +1,237 @@
+//
+// Per-cpu timer queues and the clock tick.
+//
+// Each cpu programs its own timer for whichever comes first: its
+// next periodic clock tick, or the earliest one-shot timer on its
+// queue. With the Sstc extension that is stimecmp, which raises a
+// supervisor timer interrupt directly. Without it, it is the
+// CLINT mtimecmp, and timervec in kernelvec.S turns the
+// machine-mode timer interrupt into a supervisor software
+// interrupt. Either way devintr() calls timerintr() to run
+// whatever is due.
+// An idle cpu stops its tick altogether; see tickstop().
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "timer.h"
+#include "timepage.h"
+#include "defs.h"
+
+// mtime units between clock ticks.
+#define TICKINTERVAL (TICKNS / NSPERMTIME)
+
+// mapped into every process at TIMEPAGE by proc_pagetable().
+char timepage[PGSIZE] __attribute__((aligned (PGSIZE)));
+
+struct timerq {
+  struct spinlock lock;
+  struct timer *head;  // pending timers, soonest first
+  uint64 nexttick;     // mtime of this cpu's next clock tick
+};
+
+struct timerq timerqs[NCPU];
+
+// Program this cpu's timer for the next event on q: stimecmp if
+// the cpu has Sstc, otherwise its CLINT mtimecmp, for timervec.
+// Caller must hold q->lock, and q must be this cpu's queue.
+static void
+timerprogram(struct timerq *q)
+{
+  uint64 next = q->nexttick;
+
+  if(q->head && q->head->deadline < next)
+    next = q->head->deadline;
+  if(sstc[cpuid()])
+    w_stimecmp(next);
+  else
+    *(uint64*)CLINT_MTIMECMP(cpuid()) = next;
+}
+
+void
+clockinit(void)
+{
+  struct timerq *q;
+  struct timepage *tp = (struct timepage*)timepage;
+
+  for(q = timerqs; q < &timerqs[NCPU]; q++)
+    initlock(&q->lock, "timerq");
+
+  tp->freq = MTIME_FREQ;
+  tp->base = 0;
+  tp->mult = NSPERMTIME;
+  tp->shift = 0;
+}
+
+// start this cpu's clock tick.
+void
+clockinithart(void)
+{
+  struct timerq *q = &timerqs[cpuid()];
+
+  // let user code read the time CSR, for the time page.
+  w_scounteren(r_scounteren() | SCOUNTEREN_TM);
+
+  acquire(&q->lock);
+  q->nexttick = r_time() + TICKINTERVAL;
+  timerprogram(q);
+  release(&q->lock);
+}
+
+// Stop this cpu's clock tick while it idles, so that its next
+// timer interrupt is for its earliest pending timer, if any.
+// Interrupts must be off.
+void
+tickstop(void)
+{
+  struct timerq *q = &timerqs[cpuid()];
+
+  acquire(&q->lock);
+  q->nexttick = -1;
+  timerprogram(q);
+  release(&q->lock);
+}
+
+// Restart this cpu's clock tick after tickstop().
+void
+tickstart(void)
+{
+  struct timerq *q = &timerqs[cpuid()];
+
+  acquire(&q->lock);
+  q->nexttick = r_time() + TICKINTERVAL;
+  timerprogram(q);
+  release(&q->lock);
+}
+
+// Queue t to fire on this cpu at t->deadline.
+// t->fn and t->arg must already be set.
+void
+timer_add(struct timer *t)
+{
+  struct timerq *q;
+  struct timer **pp;
+
+  push_off();
+  q = &timerqs[cpuid()];
+  acquire(&q->lock);
+  for(pp = &q->head; *pp && (*pp)->deadline <= t->deadline; pp = &(*pp)->next)
+    ;
+  t->next = *pp;
+  *pp = t;
+  t->q = q;
+  t->pending = 1;
+  if(q->head == t)
+    timerprogram(q);
+  release(&q->lock);
+  pop_off();
+}
+
+// Cancel t if it has not fired yet.
+// Returns 1 if it was still pending, 0 if it had fired.
+int
+timer_del(struct timer *t)
+{
+  struct timerq *q = t->q;
+  struct timer **pp;
+  int pending;
+
+  acquire(&q->lock);
+  pending = t->pending;
+  if(pending){
+    for(pp = &q->head; *pp != t; pp = &(*pp)->next)
+      ;
+    *pp = t->next;
+    t->pending = 0;
+  }
+  release(&q->lock);
+  return pending;
+}
+
+// Called by devintr() on this cpu's timer interrupt.
+// Fires every timer that is due, and reprograms mtimecmp.
+// Returns 1 if a clock tick was due, 0 if only one-shot timers.
+int
+timerintr(void)
+{
+  struct timerq *q = &timerqs[cpuid()];
+  struct timer *t;
+  void (*fn)(struct timer*);
+  uint64 now;
+  int tick = 0;
+
+  acquire(&q->lock);
+  now = r_time();
+  if(now >= q->nexttick){
+    tick = 1;
+    q->nexttick += TICKINTERVAL;
+    if(q->nexttick <= now)
+      q->nexttick = now + TICKINTERVAL;
+  }
+  while((t = q->head) != 0 && t->deadline <= now){
+    q->head = t->next;
+    // once pending is clear, t's owner may free it.
+    t->pending = 0;
+    fn = t->fn;
+    release(&q->lock);
+    fn(t);
+    acquire(&q->lock);
+    now = r_time();
+  }
+  timerprogram(q);
+  release(&q->lock);
+  return tick;
+}
+
+// clock ticks since boot.
+uint64
+uptime(void)
+{
+  return r_time() / TICKINTERVAL;
+}
+
+// nanoseconds since boot.
+// must agree with timenow() in user/ulib.c.
+uint64
+nanotime(void)
+{
+  struct timepage *tp = (struct timepage*)timepage;
+
+  return ((r_time() - tp->base) * tp->mult) >> tp->shift;
+}
+
+static void
+nanowakeup(struct timer *t)
+{
+  wakeup(t);
+}
+
+// Sleep for at least ns nanoseconds.
+// Returns 0, or -1 if the process was killed.
+int
+nanosleep(uint64 ns)
+{
+  struct timer t;
+  struct proc *p = myproc();
+
+  t.deadline = r_time() + (ns + NSPERMTIME - 1) / NSPERMTIME;
+  t.fn = nanowakeup;
+  t.arg = p;
+  timer_add(&t);
+
+  acquire(&t.q->lock);
+  while(t.pending){
+    if(killed(p)){
+      release(&t.q->lock);
+      timer_del(&t);
+      return -1;
+    }
+    sleep(&t, &t.q->lock);
+  }
+  release(&t.q->lock);
+  return 0;
+}
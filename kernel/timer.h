@@ -0,0 +1,15 @@
+// nanoseconds per mtime unit.
+#define NSPERMTIME (1000000000L / MTIME_FREQ)
+
+// A one-shot timer. timer_add() queues it on the calling cpu,
+// whose timer interrupt calls fn(t) once mtime reaches deadline.
+struct timer {
+  uint64 deadline;           // mtime at which to fire
+  void (*fn)(struct timer*); // called without any timer lock held
+  void *arg;                 // for fn's use
+
+  // the lock of the queue q must be held when using these:
+  int pending;               // queued and not yet fired?
+  struct timerq *q;          // queue of the cpu it was added on
+  struct timer *next;        // next timer on that queue, by deadline
+};
@@ -0,0 +1,126 @@
+//
+// Kernel event trace.
+//
+// Each hart records events into its own ring, with interrupts
+// off, so recording takes no locks. A full ring overwrites its
+// oldest events, so the trace always holds the latest ones.
+// traceread() copies events out from under the writer, and then
+// checks the head to see if the writer overwrote them meanwhile.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+#define NTRACE 2048  // events per hart
+
+struct tracebuf {
+  uint64 head;     // events recorded; written only by its hart
+  uint64 tail;     // events traceread() is done with
+  uint64 lost;     // events overwritten before traceread() got them
+  struct traceev ev[NTRACE];
+} tracebufs[NCPU];
+
+int tracemask;               // TRACE_* categories being recorded
+struct spinlock tracelock;   // tails and lost counts
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record an event on this hart. Callers check tracemask first,
+// so that tracing costs one load when it is off.
+void
+trace(int type, uint64 arg, int arg2)
+{
+  struct tracebuf *b;
+  struct traceev *e;
+  struct proc *p;
+
+  push_off();
+  b = &tracebufs[cpuid()];
+  p = mycpu()->proc;
+  e = &b->ev[b->head % NTRACE];
+  e->time = r_time();
+  e->arg = arg;
+  e->pid = p ? p->pid : 0;
+  e->arg2 = arg2;
+  e->type = type;
+  e->hart = cpuid();
+  // the event must be in place before the head counts it.
+  __sync_synchronize();
+  b->head++;
+  pop_off();
+}
+
+// Record events of the categories in mask, or stop if mask is 0.
+// Starting throws away what was recorded before. Returns how many
+// events were lost to full rings since the last call, or -1 if
+// mask is bad.
+int
+tracectl(int mask)
+{
+  struct tracebuf *b;
+  int lost = 0;
+
+  if(mask & ~TRACE_ALL)
+    return -1;
+
+  acquire(&tracelock);
+  if(tracemask == 0 && mask){
+    for(b = tracebufs; b < &tracebufs[NCPU]; b++)
+      b->tail = b->head;
+  }
+  for(b = tracebufs; b < &tracebufs[NCPU]; b++){
+    lost += b->lost;
+    b->lost = 0;
+  }
+  tracemask = mask;
+  release(&tracelock);
+  return lost;
+}
+
+// Copy up to n recorded events, each hart's in order, to user
+// address addr, and forget them. Returns how many.
+int
+traceread(uint64 addr, int n)
+{
+  struct tracebuf *b;
+  struct traceev e;
+  uint64 head;
+  int i = 0;
+
+  acquire(&tracelock);
+  for(b = tracebufs; b < &tracebufs[NCPU] && i < n; b++){
+    head = b->head;
+    __sync_synchronize();
+    if(head - b->tail > NTRACE){
+      b->lost += head - NTRACE - b->tail;
+      b->tail = head - NTRACE;
+    }
+    for(; b->tail < head && i < n; b->tail++){
+      e = b->ev[b->tail % NTRACE];
+      __sync_synchronize();
+      // once the writer has started on the event NTRACE later,
+      // e may be a mix of the two.
+      if(b->tail + NTRACE <= b->head){
+        b->lost++;
+        continue;
+      }
+      if(copyout(myproc()->pagetable, addr + i*sizeof(e), (char*)&e, sizeof(e)) < 0){
+        release(&tracelock);
+        return -1;
+      }
+      i++;
+    }
+  }
+  release(&tracelock);
+  return i;
+}
@@ -0,0 +1,28 @@
+// Kernel event trace; see tracectl() and traceread().
+
+// categories, for tracectl()'s mask.
+#define TRACE_SYSCALL  1  // system call entry and exit
+#define TRACE_IRQ      2  // device and clock interrupts
+#define TRACE_SCHED    4  // processes switching onto and off harts
+#define TRACE_SLEEP    8  // sleep() and wakeup() channels
+#define TRACE_ALL      15
+
+// event types.
+#define TR_SYSCALL    1  // arg: system call number
+#define TR_SYSRET     2  // arg: return value; arg2: system call number
+#define TR_IRQ        3  // arg: PLIC irq, or 0 for the clock and IPIs
+#define TR_IRQDONE    4  // arg: as for TR_IRQ
+#define TR_SWITCHIN   5  // pid starts running on hart
+#define TR_SWITCHOUT  6  // pid stops; arg: its new enum procstate
+#define TR_SLEEP      7  // arg: channel
+#define TR_WAKEUP     8  // arg: channel; arg2: pid woken
+
+struct traceev {
+  uint64 time;   // mtime
+  uint64 arg;
+  int pid;       // process running on the hart, or 0
+  int arg2;
+  uchar type;    // TR_*
+  uchar hart;
+  uchar pad[6];
+};
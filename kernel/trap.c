@@ -4,11 +4,9 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "trace.h"
 #include "defs.h"
 
-struct spinlock tickslock;
-uint ticks;
-
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -16,12 +14,6 @@ void kernelvec();
 
 extern int devintr();
 
-void
-trapinit(void)
-{
-  initlock(&tickslock, "time");
-}
-
 // set up to take exceptions and traps while in the kernel.
 void
 trapinithart(void)
@@ -46,6 +38,13 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+
+  // charge the time, and what the performance counters
+  // counted, since usertrapret() to user space.
+  uint64 now = r_time();
+  p->utime += now - p->tstamp;
+  p->tstamp = now;
+  perfcharge(p);
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -68,6 +67,10 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    // there is no demand paging, so a page fault is fatal,
+    // but count it anyway.
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      p->nfaults++;
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     setkilled(p);
@@ -76,10 +79,15 @@ usertrap(void)
   if(killed(p))
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if this is a timer interrupt,
+  // unless a real-time process is entitled to keep it.
+  if(which_dev == 2 && needresched(p))
     yield();
 
+  // take queued system calls, if the process asked us to.
+  if(which_dev == 2)
+    ringpoll();
+
   usertrapret();
 }
 
@@ -96,6 +104,11 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  // charge the time since usertrap() to the kernel.
+  uint64 now = r_time();
+  p->stime += now - p->tstamp;
+  p->tstamp = now;
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -122,11 +135,14 @@ usertrapret(void)
   // tell trampoline.S the user page table to switch to.
   uint64 satp = MAKE_SATP(p->pagetable);
 
+  // user space's counts start here; usertrap() charges them.
+  perfstamp(p);
+
   // jump to userret in trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, p->tfva);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -144,14 +160,20 @@ kerneltrap()
   if(intr_get() != 0)
     panic("kerneltrap: interrupts enabled");
 
+  // kernelvec leaves s0 alone, so the frame pointer we saved on
+  // entry is the interrupted code's; the profiler starts there.
+  mycpu()->trapfp = *(uint64*)(r_fp() - 16);
+
   if((which_dev = devintr()) == 0){
     printf("scause %p\n", scause);
     printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  // give up the CPU if this is a timer interrupt,
+  // unless a real-time process is entitled to keep it.
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING &&
+     needresched(myproc()))
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -160,15 +182,6 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
-clockintr()
-{
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
-}
-
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
@@ -178,6 +191,7 @@ int
 devintr()
 {
   uint64 scause = r_scause();
+  uint64 t0 = r_time();  // for statirq()
 
   if((scause & 0x8000000000000000L) &&
      (scause & 0xff) == 9){
@@ -185,6 +199,8 @@ devintr()
 
     // irq indicates which device interrupted.
     int irq = plic_claim();
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQ, irq, 0);
     if (irq == UART0_IRQ) {
       uartintr();
     } else if (irq == VIRTIO0_IRQ) {
@@ -204,23 +220,54 @@ devintr()
     // the PLIC allows each device to raise at most one
     // interrupt at a time; tell the PLIC the device is
     // now allowed to interrupt again.
-    if(irq)
+    if(irq){
       plic_complete(irq);
+      statirq(irq, t0);
+    }
 
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQDONE, irq, 0);
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or IPI, forwarded by timervec in kernelvec.S.
+    int resched;
+
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQ, 0, 0);
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before looking for its causes.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    resched = ipiintr();
+
+    // a one-shot timer alone is not a reason to preempt.
+    if(timerintr()){
+      resched = 1;
+      stattick();
+    }
+
+    statirq(0, t0);
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQDONE, 0, 0);
+    return resched ? 2 : 1;
+  } else if(scause == 0x8000000000000005L){
+    // supervisor timer interrupt, from stimecmp (Sstc).
+    // timerintr() clears it by programming the next one.
+    int resched;
+
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQ, 0, 0);
+
+    // a one-shot timer alone is not a reason to preempt.
+    if((resched = timerintr()) != 0)
+      stattick();
+
+    statirq(0, t0);
+    if(tracemask & TRACE_IRQ)
+      trace(TR_IRQDONE, 0, 0);
+    return resched ? 2 : 1;
   } else {
     return 0;
   }
@@ -6,6 +6,7 @@
 #include "virtio.h"
 #include "param.h"
 #include "proc.h"
+#include "pollq.h"
 
 /*
 Self note from the virtio specification:
@@ -41,6 +42,8 @@ struct virtq_used *used;
 uint32 used_idx = 0;
 // lock for managing hart access to code and ISR await
 struct spinlock gpulock;
+// poll()s waiting for the request in flight to finish
+struct pollq gpupollq;
 // this is it- the magic framebuffer
 // to clarify, this is our local copy that we upload to the host
 // Has to be page-aligned so PTEs work. GCC extension.
@@ -60,18 +63,20 @@ struct virtio_gpu_resource_flush flushreq;
 uint32 response;
 // is request in flight? 1 if so, 0 otherwise
 uint32 request_inflight = 0;
+// has init_virtiogpu() finished? it may run on another hart while
+// the first processes start, so user requests wait for it.
+int gpuready = 0;
 // pid of process with exclusive framebuffer access, -1 otherwise
 #define NOT_LOCKED -1
 int locked_pid = NOT_LOCKED;
 
 // function declarations
 // KERNEL INIT - called once entirely in kernel mode, exclusive control over interrupts
+void init_virtiogpu_locks(void);
 void probe_mmio(void);
 void create_device_fb(void);
 void attach_fb(void);
 void config_scanout(void);
-void transfer_fb(void);
-void flush_resource(void);
 void bind_desc_and_fire(void * req_addr, uint32 req_size);
 // USER SYSCALL - called from a syscall from a user process, does not mess with interrupt masking and properly yields
 void transfer_fb_us(void);
@@ -85,11 +90,17 @@ int get_current_pid(void);
 
 // KERNEL INIT
 
+// Set up the locks early in boot, so that system calls can wait for
+// init_virtiogpu() to finish
+void init_virtiogpu_locks(void) {
+	initlock(&gpulock,"gpulock");
+	pollqinit(&gpupollq);
+}
+
 // Initialise the virtiogpu device fully, including device handshaking and any
-// virtio commands that need to be sent to make it ready for *us* before we leave
-// the initialisation phase of xv6
+// virtio commands that need to be sent to make it ready for *us*. Runs on
+// whichever hart gets to it first; see main.c
 void init_virtiogpu(void) {
-	initlock(&gpulock,"gpulock");
 	printf("initialising virtiogpu\n");
 	printf("framebuffer at %p\n",&framebuffer);
 	// determine where it is plugged in
@@ -173,11 +184,17 @@ void init_virtiogpu(void) {
 
 	printf("virtio gpu status: %d\n",*V1(VIRTIO_MMIO_STATUS));
 	// continue initialisation
+	// nothing is drawn until Doom's first gpucmd(0) transfers and flushes
 	create_device_fb();
 	attach_fb();
 	config_scanout();
-	transfer_fb();
-	flush_resource();
+
+	// let user requests through
+	acquire(&gpulock);
+	gpuready = 1;
+	release(&gpulock);
+	wakeup(&request_inflight);
+	pollwake(&gpupollq);
 }
 
 // Probe the MMIO ports we expect and print what is there
@@ -253,6 +270,7 @@ void virtiogpu_isr(void) {
 	release(&gpulock);
 	// awake userspace threads
 	wakeup(&request_inflight);
+	pollwake(&gpupollq);
 }
 
 // Create the framebuffer on the hypervisor side
@@ -260,12 +278,6 @@ void create_device_fb(void) {
 	// hold lock for requesting
 	acquire(&gpulock);
 	request_inflight = 1;
-	// fill framebuffer with red to make debugging easier
-	for (uint32 i = 0; i < FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT; i++) {
-		uint32 y = i / FRAMEBUFFER_WIDTH; // green
-		uint32 x = i % FRAMEBUFFER_WIDTH; // red
-		framebuffer[i] = 0x000000FF | (x & 0xFF) << 8 | (y & 0xFF) << 16; // BGRA order
-	}
 
 	// create the request struct-or at least write it
 	struct virtio_gpu_resource_create_2d * req = &createreq;
@@ -316,46 +328,6 @@ void config_scanout(void) {
 	printf("config_scanout ends\n");
 }
 
-// Transfer framebuffer to the hypervisor's framebuffer
-void transfer_fb(void) {
-	// hold lock for requesting
-	acquire(&gpulock);
-	request_inflight = 1;
-	// create the request struct
-	struct virtio_gpu_transfer_to_host_2d * req = &transreq;
-	req->hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
-	req->resource_id = 666; // should not matter what is here theoretically as long as it is consistent
-	req->r.x = 0;
-	req->r.y = 0;
-	req->r.height = FRAMEBUFFER_HEIGHT;
-	req->r.width = FRAMEBUFFER_WIDTH;
-	req->offset = 0; // whole fb transfer so no meaningful offset
-	req->padding = 0; // just to be safe
-	
-	bind_desc_and_fire(req,sizeof(struct virtio_gpu_transfer_to_host_2d));
-	printf("transfer_fb ends\n");
-}
-
-// Flush the screen so the framebuffer is drawn
-// Partial flushing of selected areas is possible, but this is not used
-void flush_resource(void) {
-	// hold lock for requesting
-	acquire(&gpulock);
-	request_inflight = 1;
-	// create the request struct
-	struct virtio_gpu_resource_flush * req = &flushreq;
-	req->hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
-	req->resource_id = 666; // should not matter what is here theoretically as long as it is consistent
-	req->r.x = 0;
-	req->r.y = 0;
-	req->r.height = FRAMEBUFFER_HEIGHT;
-	req->r.width = FRAMEBUFFER_WIDTH;
-	req->padding = 0; // again, to be safe
-	
-	bind_desc_and_fire(req,sizeof(struct virtio_gpu_resource_flush));
-	printf("resource_flush ends\n");
-}
-
 // Bind the needed descriptors for input/output buffers, fire the request, and wait
 // until after the ISR finishes. Kernel init only.
 void bind_desc_and_fire(void * req_addr, uint32 req_size) {
@@ -463,10 +435,21 @@ void bind_desc_and_fire_us(void * req_addr, uint32 req_size) {
 	release(&gpulock);
 }
 
+// Is virtiogpu dormant? For poll(), which waits on *qp for
+// the request in flight to finish.
+int gpupoll(struct pollq **qp) {
+	int dormant;
+	acquire(&gpulock);
+	dormant = gpuready && request_inflight == 0;
+	release(&gpulock);
+	*qp = &gpupollq;
+	return dormant;
+}
+
 // Sleep the current process until virtiogpu becomes dormant.
 void sleep_until_dormant(void) {
 	// printf("waiting for dormant virtiogpu\n");
-	while (request_inflight == 1) {
+	while (request_inflight == 1 || !gpuready) {
 		sleep(&request_inflight,&gpulock);
 	}
 	// printf("virtiogpu now dormant\n");
@@ -4,6 +4,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "virtio.h"
+#include "pollq.h"
 #include "input-event-codes.h"
 
 #define VIRTIO_MMIO_MAGIC_VALUE_EXPECTED 0x74726976
@@ -40,6 +41,8 @@ uint32 eventq_used_idx = 0;
 uint32 statusq_used_idx = 0;
 // lock for managing hart access to code and ISR await from multiple harts
 struct spinlock kbdlock;
+// poll()s waiting for a key event
+struct pollq kbdpollq;
 
 // holds the array of buffers holding input event data we are waiting to get
 // each buffer is mapped to the virtio descriptor with the same index i.e. iea[43] is used for descriptor 43
@@ -60,8 +63,15 @@ int find_available_buffer_eventq(void){
 	return -1;
 }
 
-void init_virtiokbd(void) {
+// Set up the locks early in boot: kbdcmd() and poll() may come
+// before init_virtiokbd(), which runs on whichever hart gets to it
+// first (see main.c), and just find no events yet
+void init_virtiokbd_locks(void) {
 	initlock(&kbdlock, "kbdlock");
+	pollqinit(&kbdpollq);
+}
+
+void init_virtiokbd(void) {
 	// determine where kbd is
 	//probe_mmio();
 
@@ -189,36 +199,7 @@ void init_virtiokbd(void) {
 	// force cpu to writethrough to virtio mmio address space
 	__sync_synchronize();
 	printf("VIRTIO_INPUT_CFG_ID_NAME: %s\n", kbd_input_conf->u.string);
-	
-	// ID_SERIAL
-	kbd_input_conf->select = VIRTIO_INPUT_CFG_ID_SERIAL;
-        kbd_input_conf->subsel = 0;
-	__sync_synchronize();
-	printf("VIRTIO_INPUT_CFG_ID_SERIAL: %s\n", kbd_input_conf->u.string);
-	
-	// ID_DEVIDS
-	kbd_input_conf->select = VIRTIO_INPUT_CFG_ID_DEVIDS;
-        kbd_input_conf->subsel = 0;
-        __sync_synchronize();
-        printf("VIRTIO_INPUT_CFG_ID_DEVIDS (bustype): %d\n", kbd_input_conf->u.ids.bustype);
-        printf("VIRTIO_INPUT_CFG_ID_DEVIDS (vendor): %d\n", kbd_input_conf->u.ids.vendor);
-        printf("VIRTIO_INPUT_CFG_ID_DEVIDS (product): %d\n", kbd_input_conf->u.ids.product);
-        printf("VIRTIO_INPUT_CFG_ID_DEVIDS (version): %d\n", kbd_input_conf->u.ids.version);
 
-	// PROP_BITS
-	kbd_input_conf->select = VIRTIO_INPUT_CFG_PROP_BITS;
-        kbd_input_conf->subsel = 0;
-        __sync_synchronize();
-        printf("VIRTIO_INPUT_CFG_PROP_BITS: %d\n", kbd_input_conf->u.bitmap[0]);
-
-	// EV_BITS
-	kbd_input_conf->select = VIRTIO_INPUT_CFG_EV_BITS;
-        kbd_input_conf->subsel = EV_KEY;
-        __sync_synchronize();
-	if (kbd_input_conf->size > 0) {
-		printf("EV_KEY supported\n");
-        	printf("VIRTIO_INPUT_CFG_EV_BITS: %s\n", kbd_input_conf->u.bitmap);	
-	}
 	/*
 	// ABS_INFO
 	kbd_input_conf->select = VIRTIO_INPUT_CFG_ABS_INFO;
@@ -277,6 +258,18 @@ void virtiokbd_isr(void) {
 	}
 	release(&kbdlock);
 	printf("virtiokbd released the lock\n");
+	pollwake(&kbdpollq);
+}
+
+// Is there a key event waiting for kbdcmd()? For poll(), which
+// waits on *qp for one to arrive.
+int kbdpoll(struct pollq **qp){
+	int ready;
+	acquire(&kbdlock);
+	ready = event_buffer_count > 0;
+	release(&kbdlock);
+	*qp = &kbdpollq;
+	return ready;
 }
 
 // Set up the descriptor desc_idx, prepare it's associated buffer and fire the request into the eventq
@@ -39,6 +39,9 @@ kvmmake(void)
   // try for audio as well
   kvmmap(kpgtbl, VIRTIO3, VIRTIO3, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, so each hart can program its own mtimecmp.
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -111,6 +114,19 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   return &pagetable[PX(0, va)];
 }
 
+// How many pages of user memory below sz are mapped.
+uint64
+uvmresident(pagetable_t pagetable, uint64 sz)
+{
+  uint64 a, n = 0;
+  pte_t *pte;
+
+  for(a = 0; a < sz; a += PGSIZE)
+    if((pte = walk(pagetable, a, 0)) != 0 && (*pte & PTE_V))
+      n++;
+  return n;
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
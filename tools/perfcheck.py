@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Compare the key=value lines from a make perf run against a
+# baseline, and print a table of what got slower.
+#
+#   tools/perfcheck.py [-u] results baseline.json
+#
+# Each metric is a time, so lower is better: the median and p99
+# of each user/bench.c test, in ns, and the milliseconds a Doom
+# -timedemo took, in all and for its 99th percentile frame.
+# Under -icount these count instructions, so they come out the
+# same from run to run, and a small threshold catches real
+# regressions. A metric fails when it is more than
+# its threshold, in percent, above the baseline. A metric with
+# no baseline value is listed as NEW and not checked, and if no
+# metric has one, the check fails. -u records the results as the
+# new baseline, keeping the thresholds.
+#
+# The baseline looks like:
+#
+#   {"threshold": 5,
+#    "metrics": {"bench.getpid.median": {"value": 850},
+#                "timedemo.demo1.ms": {"value": 41000, "threshold": 2}}}
+
+import argparse
+import json
+import sys
+
+
+def parse(path):
+    metrics = {}
+    for line in open(path):
+        kv = dict(f.split('=', 1) for f in line.split() if '=' in f)
+        if 'bench' in kv and 'median' in kv:
+            for k in ('median', 'p99'):
+                metrics['bench.%s.%s' % (kv['bench'], k)] = int(kv[k])
+        elif 'timedemo' in kv and 'ms' in kv:
+            for k in ('ms', 'p99ms'):
+                if k in kv:
+                    metrics['timedemo.%s.%s' % (kv['timedemo'], k)] = int(kv[k])
+    return metrics
+
+
+def main():
+    ap = argparse.ArgumentParser(prog='perfcheck.py')
+    ap.add_argument('-u', dest='update', action='store_true',
+                    help='record the results as the baseline')
+    ap.add_argument('results')
+    ap.add_argument('baseline')
+    args = ap.parse_args()
+
+    cur = parse(args.results)
+    if not cur:
+        sys.exit('perfcheck: no results in %s' % args.results)
+    try:
+        base = json.load(open(args.baseline))
+    except FileNotFoundError:
+        base = {}
+    base.setdefault('threshold', 5)
+    base.setdefault('metrics', {})
+
+    if args.update:
+        for name, v in cur.items():
+            base['metrics'].setdefault(name, {})['value'] = v
+        with open(args.baseline, 'w') as f:
+            json.dump(base, f, indent=2, sort_keys=True)
+            f.write('\n')
+        print('perfcheck: recorded %d metrics in %s' % (len(cur), args.baseline))
+        return
+
+    fails = checked = unchecked = 0
+    fmt = '%-28s %12s %12s %8s %6s  %s'
+    print(fmt % ('metric', 'baseline', 'result', 'change', 'limit', ''))
+    names = sorted(set(cur) | set(base['metrics']))
+    for name in names:
+        m = base['metrics'].get(name, {})
+        limit = m.get('threshold', base['threshold'])
+        old = m.get('value')
+        new = cur.get(name)
+        if new is None:
+            # not recorded yet, and not run this time either.
+            if old is None:
+                continue
+            print(fmt % (name, old, '-', '', '', 'MISSING'))
+            checked += 1
+            fails += 1
+            continue
+        if old is None:
+            print(fmt % (name, '-', new, '', '', 'NEW'))
+            unchecked += 1
+            continue
+        checked += 1
+        change = 100.0 * (new - old) / old if old else 0.0
+        ok = change <= limit
+        fails += not ok
+        print(fmt % (name, old, new, '%+.1f%%' % change, '%g%%' % limit,
+                     'pass' if ok else 'FAIL'))
+    print('perfcheck: %d of %d metrics failed' % (fails, checked))
+    # a baseline without values would pass anything.
+    if unchecked:
+        print('perfcheck: %d metrics have no baseline value; '
+              'make perf-baseline records them' % unchecked)
+    if checked == 0:
+        sys.exit('perfcheck: nothing checked, as %s has no values'
+                 % args.baseline)
+    sys.exit(1 if fails else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# Make sense of the samples user/prof.c saved: read the sample
+# file out of fs.img, symbolize each pc and return address against
+# kernel/kernel.sym or user/<name>.sym, and print a flat profile
+# and a call graph.
+#
+#   tools/profsym.py [-p pid] [-n lines] file [fs.img]
+#
+# run from the top of the tree, after xv6 has shut down (or at
+# least gone quiet), so that fs.img holds the whole file.
+
+import collections
+import struct
+import sys
+
+from xv6fs import readfile, symbols
+
+# kernel/prof.h
+PROFDEPTH = 8
+SAMPLE = struct.Struct('<iBBBB16sQ%dQ' % PROFDEPTH)
+
+
+def symbolize(kernel, name, pc):
+    if kernel:
+        return symbols('kernel/kernel.sym').name(pc)
+    prog = name.split('/')[-1].lstrip('_')
+    return '%s:%s' % (prog, symbols('user/%s.sym' % prog).name(pc))
+
+
+def usage():
+    sys.stderr.write('usage: profsym.py [-p pid] [-n lines] file [fs.img]\n')
+    sys.exit(1)
+
+
+def main(argv):
+    pid = None
+    lines = 30
+    while argv and argv[0].startswith('-'):
+        if argv[0] == '-p' and len(argv) > 1:
+            pid = int(argv[1])
+        elif argv[0] == '-n' and len(argv) > 1:
+            lines = int(argv[1])
+        else:
+            usage()
+        argv = argv[2:]
+    if len(argv) not in (1, 2):
+        usage()
+    img = argv[1] if len(argv) == 2 else 'fs.img'
+
+    data = readfile(argv[0], img)
+
+    total = 0
+    idle = 0
+    self_ = collections.Counter()
+    incl = collections.Counter()
+    callers = collections.defaultdict(collections.Counter)
+    for off in range(0, len(data) - SAMPLE.size + 1, SAMPLE.size):
+        s = SAMPLE.unpack_from(data, off)
+        spid, hart, kernel, depth = s[0], s[1], s[2], s[3]
+        name = s[5].rstrip(b'\0').decode(errors='replace')
+        if pid is not None and spid != pid:
+            continue
+        total += 1
+        if spid == 0:
+            idle += 1
+        frames = [symbolize(kernel, name, s[6])]
+        # return addresses point after the call; back up into it.
+        frames += [symbolize(kernel, name, ra - 4) for ra in s[7:7 + depth]]
+        self_[frames[0]] += 1
+        for f in set(frames):
+            incl[f] += 1
+        for callee, caller in zip(frames, frames[1:]):
+            callers[callee][caller] += 1
+
+    if total == 0:
+        sys.exit('profsym: no samples')
+
+    print('%d samples, %d idle\n' % (total, idle))
+    print('flat profile:')
+    print('%8s %6s %8s %6s  %s' % ('self', '%', 'total', '%', 'function'))
+    for f, n in self_.most_common(lines):
+        print('%8d %5.1f%% %8d %5.1f%%  %s' %
+              (n, 100.0 * n / total, incl[f], 100.0 * incl[f] / total, f))
+
+    print('\ncall graph (inclusive samples; callers indented):')
+    for f, n in incl.most_common(lines):
+        print('%8d %5.1f%%  %s' % (n, 100.0 * n / total, f))
+        for c, m in callers[f].most_common(5):
+            print('%8d         <- %s' % (m, c))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
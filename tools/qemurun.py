@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+#
+# Boot xv6 under QEMU with the console on a pipe, type commands
+# at the shell, and save the key=value lines they print.
+#
+#   tools/qemurun.py [-o file] [-t secs] [-u regex] cmd ... -- qemu args ...
+#
+# Each cmd is typed at a "$ " prompt, in order. Once the last
+# has been typed, the run ends, and QEMU is killed, when a line
+# matches regex (by default "=done$", as user/bench.c ends with).
+# It fails after secs seconds. Everything the console prints is
+# echoed to stderr.
+
+import argparse
+import os
+import re
+import select
+import subprocess
+import sys
+import time
+
+KV = re.compile(r'^\w+=\S*(\s+\w+=\S*)*$')
+PROMPT = b'$ '
+
+
+def run(qemu, cmds, until, timeout):
+    proc = subprocess.Popen(qemu, stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    deadline = time.time() + timeout
+    pending = b''
+    lines = []
+    cmds = list(cmds)
+    done = False
+    try:
+        while not done:
+            left = deadline - time.time()
+            if left <= 0:
+                sys.exit('qemurun: timed out after %d seconds' % timeout)
+            r, _, _ = select.select([proc.stdout], [], [], left)
+            if not r:
+                continue
+            data = os.read(proc.stdout.fileno(), 4096)
+            if not data:
+                sys.exit('qemurun: qemu exited')
+            sys.stderr.buffer.write(data)
+            sys.stderr.flush()
+            pending += data
+            while b'\n' in pending:
+                line, pending = pending.split(b'\n', 1)
+                line = line.decode('latin-1').strip('\r')
+                # the shell's prompt runs into the line after it.
+                line = re.sub(r'^(\$ )+', '', line)
+                lines.append(line)
+                if not cmds and until.search(line):
+                    done = True
+            if cmds and pending.endswith(PROMPT):
+                proc.stdin.write(cmds.pop(0).encode() + b'\n')
+                proc.stdin.flush()
+                pending = b''
+    finally:
+        proc.kill()
+        proc.wait()
+    return lines
+
+
+def main():
+    argv = sys.argv[1:]
+    if '--' not in argv:
+        sys.exit('usage: qemurun.py [-o file] [-t secs] [-u regex] '
+                 'cmd ... -- qemu args ...')
+    i = argv.index('--')
+    ap = argparse.ArgumentParser(prog='qemurun.py')
+    ap.add_argument('-o', dest='out', help='write key=value lines here')
+    ap.add_argument('-t', dest='timeout', type=int, default=600)
+    ap.add_argument('-u', dest='until', default='=done$')
+    ap.add_argument('cmds', nargs='+')
+    args = ap.parse_args(argv[:i])
+
+    lines = run(argv[i+1:], args.cmds, re.compile(args.until), args.timeout)
+    kv = [l for l in lines if KV.match(l)]
+    out = open(args.out, 'w') if args.out else sys.stdout
+    for l in kv:
+        out.write(l + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#
+# Turn the events user/trace.c saved into Chrome trace JSON, for
+# chrome://tracing or https://ui.perfetto.dev.
+#
+#   tools/trace2json.py [-p pid] file [fs.img] > trace.json
+#
+# Each hart is a process in the trace, with the interrupts it took
+# and the xv6 processes it ran. Each xv6 process is a process too,
+# with its system calls, sleeps and wakeups. Run from the top of
+# the tree, so that kernel/syscall.h and kernel/kernel.sym are
+# there to name system calls and sleep channels.
+
+import json
+import re
+import struct
+import sys
+
+from xv6fs import readfile, symbols
+
+# kernel/trace.h
+EVENT = struct.Struct('<QQiiBB6x')
+TR_SYSCALL, TR_SYSRET, TR_IRQ, TR_IRQDONE = 1, 2, 3, 4
+TR_SWITCHIN, TR_SWITCHOUT, TR_SLEEP, TR_WAKEUP = 5, 6, 7, 8
+
+MTIME_FREQ = 10000000  # kernel/memlayout.h
+STATES = ['unused', 'used', 'sleep', 'runble', 'run', 'zombie']
+HARTPID = 100000  # trace pids for harts start here, clear of xv6's
+
+
+def syscallnames():
+    names = {}
+    try:
+        for line in open('kernel/syscall.h'):
+            m = re.match(r'#define\s+SYS_(\w+)\s+(\d+)', line)
+            if m:
+                names[int(m.group(2))] = m.group(1)
+    except OSError:
+        pass
+    return names
+
+
+def usage():
+    sys.stderr.write('usage: trace2json.py [-p pid] file [fs.img]\n')
+    sys.exit(1)
+
+
+def main(argv):
+    pid = None
+    if len(argv) > 1 and argv[0] == '-p':
+        pid = int(argv[1])
+        argv = argv[2:]
+    if len(argv) not in (1, 2):
+        usage()
+    data = readfile(argv[0], argv[1] if len(argv) == 2 else 'fs.img')
+
+    evs = [EVENT.unpack_from(data, off)
+           for off in range(0, len(data) - EVENT.size + 1, EVENT.size)]
+    if not evs:
+        sys.exit('trace2json: no events')
+    # each hart's events are in order, but the harts' are not.
+    evs.sort(key=lambda e: e[0])
+    t0 = evs[0][0]
+
+    sysnames = syscallnames()
+    ksyms = symbols('kernel/kernel.sym')
+    out = []
+    harts = set()
+    pids = set()
+    # depth of B events without their E on each track, so that a
+    # trace that starts in the middle of a slice stays well formed.
+    open_ = {}
+
+    def emit(ph, name, tpid, ts, args=None):
+        if ph == 'B':
+            open_[tpid] = open_.get(tpid, 0) + 1
+        elif ph == 'E':
+            if open_.get(tpid, 0) == 0:
+                return
+            open_[tpid] -= 1
+        e = {'ph': ph, 'name': name, 'pid': tpid, 'tid': tpid, 'ts': ts}
+        if ph == 'i':
+            e['s'] = 't'
+        if args:
+            e['args'] = args
+        out.append(e)
+
+    for time, arg, epid, arg2, typ, hart in evs:
+        if pid is not None and epid != pid and not (typ == TR_WAKEUP and arg2 == pid):
+            continue
+        ts = (time - t0) * 1e6 / MTIME_FREQ
+        htrack = HARTPID + hart
+        harts.add(hart)
+        if epid:
+            pids.add(epid)
+
+        if typ == TR_SYSCALL:
+            emit('B', sysnames.get(arg, 'sys%d' % arg), epid, ts)
+        elif typ == TR_SYSRET:
+            ret = arg - (1 << 64) if arg >= 1 << 63 else arg
+            emit('E', sysnames.get(arg2, 'sys%d' % arg2), epid, ts,
+                 {'ret': ret})
+        elif typ == TR_IRQ:
+            emit('B', 'irq %d' % arg if arg else 'clock/ipi', htrack, ts)
+        elif typ == TR_IRQDONE:
+            emit('E', 'irq %d' % arg if arg else 'clock/ipi', htrack, ts)
+        elif typ == TR_SWITCHIN:
+            emit('B', 'pid %d' % epid, htrack, ts)
+        elif typ == TR_SWITCHOUT:
+            state = STATES[arg] if arg < len(STATES) else str(arg)
+            emit('E', 'pid %d' % epid, htrack, ts, {'to': state})
+        elif typ == TR_SLEEP:
+            emit('i', 'sleep', epid, ts, {'chan': ksyms.offset(arg)})
+        elif typ == TR_WAKEUP:
+            # interrupts wake processes with none running.
+            emit('i', 'wakeup pid %d' % arg2, epid or htrack, ts,
+                 {'chan': ksyms.offset(arg)})
+
+    for h in sorted(harts):
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': HARTPID + h,
+                    'args': {'name': 'hart %d' % h}})
+        out.append({'ph': 'M', 'name': 'process_sort_index',
+                    'pid': HARTPID + h, 'args': {'sort_index': h}})
+    for p in sorted(pids):
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': p,
+                    'args': {'name': 'pid %d' % p}})
+
+    json.dump({'traceEvents': out, 'displayTimeUnit': 'ns'}, sys.stdout)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
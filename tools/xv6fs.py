@@ -0,0 +1,102 @@
+# Helpers shared by the host tools: reading a file out of an
+# xv6 fs.img, and looking up addresses in a .sym file.
+
+import bisect
+import struct
+
+# kernel/fs.h
+BSIZE = 65536
+NDIRECT = 12
+ROOTINO = 1
+DIRSIZ = 14
+DINODE = struct.Struct('<hhhhI%dI' % (NDIRECT + 1))
+DIRENT = struct.Struct('<H%ds' % DIRSIZ)
+
+
+class FS:
+    def __init__(self, path):
+        self.img = open(path, 'rb')
+        sb = struct.unpack('<8I', self.block(1)[:32])
+        self.inodestart = sb[6]
+
+    def block(self, b):
+        self.img.seek(b * BSIZE)
+        return self.img.read(BSIZE)
+
+    def inode(self, inum):
+        ipb = BSIZE // DINODE.size
+        blk = self.block(self.inodestart + inum // ipb)
+        off = (inum % ipb) * DINODE.size
+        d = DINODE.unpack_from(blk, off)
+        return d[4], d[5:]
+
+    def read(self, inum):
+        size, addrs = self.inode(inum)
+        blocks = list(addrs[:NDIRECT])
+        if addrs[NDIRECT]:
+            ind = self.block(addrs[NDIRECT])
+            blocks += struct.unpack('<%dI' % (BSIZE // 4), ind)
+        data = bytearray()
+        for b in blocks:
+            if len(data) >= size:
+                break
+            data += self.block(b) if b else bytes(BSIZE)
+        return bytes(data[:size])
+
+    def lookup(self, name):
+        root = self.read(ROOTINO)
+        for off in range(0, len(root), DIRENT.size):
+            inum, n = DIRENT.unpack_from(root, off)
+            if inum and n.rstrip(b'\0').decode() == name:
+                return inum
+        return None
+
+
+class Symbols:
+    def __init__(self, path):
+        syms = []
+        try:
+            for line in open(path):
+                f = line.split()
+                if len(f) == 2:
+                    syms.append((int(f[0], 16), f[1]))
+        except OSError:
+            pass
+        syms.sort()
+        self.addrs = [a for a, _ in syms]
+        self.names = [n for _, n in syms]
+
+    def name(self, pc):
+        """The function containing pc."""
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0:
+            return '0x%x' % pc
+        return self.names[i]
+
+    def offset(self, addr):
+        """addr as symbol+offset, for data addresses."""
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return '0x%x' % addr
+        if addr == self.addrs[i]:
+            return self.names[i]
+        return '%s+0x%x' % (self.names[i], addr - self.addrs[i])
+
+
+symcache = {}
+
+
+def symbols(path):
+    """Symbols from path, read once."""
+    if path not in symcache:
+        symcache[path] = Symbols(path)
+    return symcache[path]
+
+
+def readfile(name, img):
+    """The contents of file name in fs.img img, or exit."""
+    fs = FS(img)
+    inum = fs.lookup(name.lstrip('/'))
+    if inum is None:
+        raise SystemExit('no %s in %s' % (name, img))
+    return fs.read(inum)
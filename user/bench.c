@@ -0,0 +1,368 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// Kernel and system call microbenchmarks.
+//
+//   bench [-n iters] [test ...]
+//
+// Each test times its operation iters times (default 200) and
+// prints a line of key=value pairs with the minimum, median and
+// 99th percentile, in nanoseconds per operation:
+//
+//   bench=getpid n=200 batch=100 min=812 median=850 p99=1200
+//
+// Operations too quick for the clock run in batches, and a
+// sample is a batch's time over its size. Tests that move data
+// add kbps, from the median. A last "bench=done" line marks the
+// end for scripts; make bench runs this under QEMU.
+
+#define MAXN    10000
+#define BLK     65536              // a file system block
+#define FILESZ  (64*BLK)           // more than the buffer cache holds
+#define BENCHFILE "benchfile"
+
+static char buf[BLK];
+static uint64 samples[MAXN];
+static char *prog;
+static int fd;
+static int fds[2], fds2[2];
+static uint32 *fb;
+static uint rnd = 1;
+
+static void
+die(char *what)
+{
+  fprintf(2, "bench: %s failed\n", what);
+  exit(1);
+}
+
+// the same blocks every run, so runs compare.
+static int
+randblk(void)
+{
+  rnd = rnd * 1103515245 + 12345;
+  return (rnd >> 16) % (FILESZ / BLK);
+}
+
+static void
+opnull(void)
+{
+  dup(-1);
+}
+
+static void
+opgetpid(void)
+{
+  getpid();
+}
+
+static void
+opfork(void)
+{
+  int pid;
+
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0)
+    exit(0);
+  wait(0);
+}
+
+static void
+opexec(void)
+{
+  char *argv[] = { prog, "-x", 0 };
+  int pid;
+
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0){
+    exec(prog, argv);
+    die("exec");
+  }
+  wait(0);
+}
+
+// a child that echoes bytes back; the parent times
+// each round trip, two switches.
+static void
+ctxsetup(void)
+{
+  char c;
+  int pid;
+
+  if(pipe(fds) < 0 || pipe(fds2) < 0)
+    die("pipe");
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0){
+    close(fds[1]);
+    close(fds2[0]);
+    while(read(fds[0], &c, 1) == 1)
+      write(fds2[1], &c, 1);
+    exit(0);
+  }
+  close(fds[0]);
+  close(fds2[1]);
+}
+
+static void
+opctx(void)
+{
+  char c = 'x';
+
+  if(write(fds[1], &c, 1) != 1 || read(fds2[0], &c, 1) != 1)
+    die("ping-pong");
+}
+
+static void
+ctxdone(void)
+{
+  close(fds[1]);
+  close(fds2[0]);
+  wait(0);
+}
+
+// a child writes until the parent closes its end.
+static void
+pipesetup(void)
+{
+  int pid;
+
+  if(pipe(fds) < 0)
+    die("pipe");
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0){
+    close(fds[0]);
+    while(write(fds[1], buf, 4096) == 4096)
+      ;
+    exit(0);
+  }
+  close(fds[1]);
+}
+
+static void
+oppipe(void)
+{
+  int n, total;
+
+  for(total = 0; total < BLK; total += n)
+    if((n = read(fds[0], buf, BLK - total)) <= 0)
+      die("pipe read");
+}
+
+static void
+pipedone(void)
+{
+  close(fds[0]);
+  wait(0);
+}
+
+static void
+opsbrk(void)
+{
+  if(sbrk(BLK) == (char*)-1)
+    die("sbrk");
+  sbrk(-BLK);
+}
+
+static void
+mkfile(void)
+{
+  int i;
+
+  if((fd = open(BENCHFILE, O_CREATE|O_RDWR|O_TRUNC)) < 0)
+    die("create");
+  for(i = 0; i < FILESZ; i += BLK)
+    if(write(fd, buf, BLK) != BLK)
+      die("write");
+  lseek(fd, 0, SEEK_SET);
+}
+
+static void
+rmfile(void)
+{
+  close(fd);
+  unlink(BENCHFILE);
+}
+
+static void
+opopen(void)
+{
+  int fd;
+
+  if((fd = open(BENCHFILE, O_RDONLY)) < 0)
+    die("open");
+  close(fd);
+}
+
+static void
+opcreate(void)
+{
+  int fd;
+
+  if((fd = open("benchnew", O_CREATE|O_RDWR)) < 0)
+    die("create");
+  close(fd);
+  unlink("benchnew");
+}
+
+static void
+opseqread(void)
+{
+  if(read(fd, buf, BLK) != BLK){
+    lseek(fd, 0, SEEK_SET);
+    if(read(fd, buf, BLK) != BLK)
+      die("read");
+  }
+}
+
+static void
+opseqwrite(void)
+{
+  if(lseek(fd, 0, SEEK_CUR) == FILESZ)
+    lseek(fd, 0, SEEK_SET);
+  if(write(fd, buf, BLK) != BLK)
+    die("write");
+}
+
+static void
+oprandread(void)
+{
+  lseek(fd, randblk() * BLK, SEEK_SET);
+  if(read(fd, buf, BLK) != BLK)
+    die("read");
+}
+
+static void
+oprandwrite(void)
+{
+  lseek(fd, randblk() * BLK, SEEK_SET);
+  if(write(fd, buf, BLK) != BLK)
+    die("write");
+}
+
+static void
+gpusetup(void)
+{
+  fb = acquire_fb();
+}
+
+static void
+opgpu(void)
+{
+  transfer_fb();
+}
+
+static void
+gpudone(void)
+{
+  if(fb)
+    release_fb();
+}
+
+struct test {
+  char *name;
+  int batch;              // operations per sample
+  int bytes;              // moved per operation, for kbps
+  void (*setup)(void);
+  void (*op)(void);
+  void (*done)(void);
+} tests[] = {
+  { "null",      100, 0,   0,         opnull,      0 },
+  { "getpid",    100, 0,   0,         opgetpid,    0 },
+  { "fork",      1,   0,   0,         opfork,      0 },
+  { "exec",      1,   0,   0,         opexec,      0 },
+  { "ctxsw",     10,  0,   ctxsetup,  opctx,       ctxdone },
+  { "pipe",      1,   BLK, pipesetup, oppipe,      pipedone },
+  { "sbrk",      10,  0,   0,         opsbrk,      0 },
+  { "openclose", 10,  0,   mkfile,    opopen,      rmfile },
+  { "create",    1,   0,   0,         opcreate,    0 },
+  { "seqread",   1,   BLK, mkfile,    opseqread,   rmfile },
+  { "seqwrite",  1,   BLK, mkfile,    opseqwrite,  rmfile },
+  { "randread",  1,   BLK, mkfile,    oprandread,  rmfile },
+  { "randwrite", 1,   BLK, mkfile,    oprandwrite, rmfile },
+  { "gpu",       1,   0,   gpusetup,  opgpu,       gpudone },
+};
+
+static void
+sort(uint64 *a, int n)
+{
+  int gap, i, j;
+  uint64 x;
+
+  for(gap = n/2; gap > 0; gap /= 2){
+    for(i = gap; i < n; i++){
+      x = a[i];
+      for(j = i; j >= gap && a[j-gap] > x; j -= gap)
+        a[j] = a[j-gap];
+      a[j] = x;
+    }
+  }
+}
+
+static void
+run(struct test *t, int n)
+{
+  uint64 t0, med;
+  int i, j;
+
+  if(t->setup)
+    t->setup();
+  if(t->op == opgpu && fb == 0){
+    printf("bench=%s skip=1\n", t->name);
+    return;
+  }
+  // once untimed, to fault in pages and warm caches.
+  t->op();
+  for(i = 0; i < n; i++){
+    t0 = nanotime();
+    for(j = 0; j < t->batch; j++)
+      t->op();
+    samples[i] = (nanotime() - t0) / t->batch;
+  }
+  if(t->done)
+    t->done();
+
+  sort(samples, n);
+  med = samples[n/2];
+  printf("bench=%s n=%d batch=%d min=%l median=%l p99=%l", t->name, n,
+         t->batch, samples[0], med, samples[n*99/100]);
+  if(t->bytes && med)
+    printf(" kbps=%l", (uint64)t->bytes * 1000000000 / med / 1024);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n = 200, any;
+
+  // exec's child.
+  if(argc == 2 && strcmp(argv[1], "-x") == 0)
+    exit(0);
+
+  prog = argv[0];
+  i = 1;
+  if(argc > 2 && strcmp(argv[1], "-n") == 0){
+    n = atoi(argv[2]);
+    i = 3;
+  }
+  if(n < 1 || n > MAXN){
+    fprintf(2, "usage: bench [-n iters] [test ...]\n");
+    exit(1);
+  }
+
+  for(j = 0; j < sizeof(tests)/sizeof(tests[0]); j++){
+    any = i == argc;
+    for(int k = i; k < argc; k++)
+      if(strcmp(argv[k], tests[j].name) == 0)
+        any = 1;
+    if(any)
+      run(&tests[j], n);
+  }
+  printf("bench=done\n");
+  exit(0);
+}
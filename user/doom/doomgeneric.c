@@ -306,12 +306,11 @@ void DG_DrawFrame() {
 }
 
 void DG_SleepMs(uint32_t ms) {
-	sleep(ms);
+	nanosleep((uint64)ms * 1000000);
 }
 
 uint32_t DG_GetTicksMs() {
-	// This is actually the number of clock ticks; each clock tick is 10ms
-	return uptime() * 30;
+	return timenow() / 1000000;
 }
 
 int DG_GetKey(int* pressed, unsigned char* key) {
@@ -110,6 +110,7 @@ boolean         usergame;               // ok to save / end game
 boolean         timingdemo;             // if true, exit with report on completion 
 boolean         nodrawers;              // for comparative timing purposes 
 int             starttime;          	// for comparative timing purposes  	 
+static int      startms;                // the same, in milliseconds
  
 boolean         viewactive; 
  
@@ -849,12 +850,53 @@ boolean G_Responder (event_t* ev)
 // G_Ticker
 // Make ticcmd_ts for the players.
 //
+//
+// Frame times of a -timedemo, in ms. With singletics, each
+// frame runs one tic, so G_Ticker is called once per frame.
+//
+#define MAXFRAMEMS 1000
+
+static int framems[MAXFRAMEMS + 1];
+static int nframes;
+static int lastframems;
+
+static void G_TimeFrame (void)
+{
+    int now = I_GetTimeMS ();
+    int ms = now - lastframems;
+
+    if (nframes++ > 0)
+        framems[ms < MAXFRAMEMS ? ms : MAXFRAMEMS]++;
+    lastframems = now;
+}
+
+// the 99th percentile frame time
+static int G_FrameP99 (void)
+{
+    int ms, n, seen;
+
+    if (nframes < 2)
+        return 0;
+    n = (nframes - 1) * 99 / 100;
+    seen = 0;
+    for (ms = 0; ms < MAXFRAMEMS; ms++)
+    {
+        seen += framems[ms];
+        if (seen > n)
+            break;
+    }
+    return ms;
+}
+
 void G_Ticker (void) 
 { 
     int		i;
     int		buf; 
     ticcmd_t*	cmd;
     
+    if (timingdemo)
+        G_TimeFrame ();
+
     // do player reborns if needed
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	if (playeringame[i] && players[i].playerstate == PST_REBORN) 
@@ -2221,6 +2263,7 @@ void G_DoPlayDemo (void)
     G_InitNew (skill, episode, map); 
     precache = true; 
     starttime = I_GetTime (); 
+    startms = I_GetTimeMS ();
 
     usergame = false; 
     demoplayback = true; 
@@ -2263,19 +2306,26 @@ boolean G_CheckDemoStatus (void)
 	 
     if (timingdemo) 
     { 
-        float fps;
+        int fps10;
         int realtics;
+        int ms;
 
 	endtime = I_GetTime (); 
         realtics = endtime - starttime;
-        fps = ((float) gametic * TICRATE) / realtics;
+        ms = I_GetTimeMS () - startms;
+        fps10 = ms > 0 ? (int) ((int64_t) gametic * 10000 / ms) : 0;
 
         // Prevent recursive calls
         timingdemo = false;
         demoplayback = false;
 
-	I_Error ("timed %i gametics in %i realtics (%f fps)",
-                 gametic, realtics, fps);
+        // For tools/perfcheck.py, as key=value pairs.
+        printf("timedemo=%s gametics=%i realtics=%i ms=%i p99ms=%i\n",
+               defdemoname, gametic, realtics, ms, G_FrameP99 ());
+
+        // The libc shim's printf has no %f.
+	I_Error ("timed %i gametics in %i realtics (%i.%i fps)",
+                 gametic, realtics, fps10 / 10, fps10 % 10);
     } 
 	 
     if (demoplayback) 
@@ -31,8 +31,20 @@
 // returns time in 1/35th second tics
 //
 
-static uint32_t basetime = 0;
+// timenow() when the game first asked for the time.
+static uint64 basetime = 0;
 
+static uint64 I_GetNanos(void)
+{
+    uint64 now;
+
+    now = timenow();
+
+    if (basetime == 0)
+        basetime = now;
+
+    return now - basetime;
+}
 
 int I_GetTicks(void)
 {
@@ -41,16 +53,7 @@ int I_GetTicks(void)
 
 int  I_GetTime (void)
 {
-    uint32_t ticks;
-
-    ticks = I_GetTicks();
-
-    if (basetime == 0)
-        basetime = ticks;
-
-    ticks -= basetime;
-
-    return (ticks * TICRATE) / 1000;    
+    return (I_GetNanos() * TICRATE) / 1000000000;
 }
 
 
@@ -60,14 +63,7 @@ int  I_GetTime (void)
 
 int I_GetTimeMS(void)
 {
-    uint32_t ticks;
-
-    ticks = I_GetTicks();
-
-    if (basetime == 0)
-        basetime = ticks;
-
-    return ticks - basetime;
+    return I_GetNanos() / 1000000;
 }
 
 // Sleep for a specified number of ms
@@ -77,7 +73,8 @@ void I_Sleep(int ms)
     //SDL_Delay(ms);
     //usleep (ms * 1000);
 
-	DG_SleepMs(ms);
+    if (ms > 0)
+        nanosleep((uint64) ms * 1000000);
 }
 
 void I_WaitVBL(int count)
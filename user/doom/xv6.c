@@ -8,204 +8,230 @@
 int stderr = 1; // Yes, this is wrong. But for compatibility...
 
 // Assist calls
-// With buf, with the given size, at the given index, put the char/str/num/unsigned/ptr at this location
-// and increment the index. If there is not enough room, place as many chars as will fit.
+// With buf, with the given size, at the given index, put the char/str/num at this location
+// and increment the index. The index keeps counting past the end of buf, so that it ends up
+// the length the whole output would have had; only the chars that fit, less one for the
+// null terminator, are stored.
 static void snputc(char * buf, size_t bufsz, int * charbufidx, int ch);
-static void snputs(char * buf, size_t bufsz, int * charbufidx, const char * str);
-static void snputi(char * buf, size_t bufsz, int * charbufidx, int64_t num, int base);
-static void snputu(char * buf, size_t bufsz, int * charbufidx, uint64_t num, int base);
-static void snputptr(char * buf, size_t bufsz, int * charbufidx, void * ptr);
+static void snpad(char * buf, size_t bufsz, int * charbufidx, int ch, int n);
+static void snputs(char * buf, size_t bufsz, int * charbufidx, const char * str, int prec, int width, int flags);
+static void snputnum(char * buf, size_t bufsz, int * charbufidx, uint64_t mag, int neg, int base, int prec, int width, int flags);
 // Convert a ASCII num to an int, assuming isdigit(c) is true
 static int ctoi(int c);
-// Like ctoi but hex digits too at the cost of speed
+// Like ctoi but hex digits too
 static int ctoix(int c);
 // Parse an int/unsigned int in buf, with the specified bufsz, at charbufidx, in the specified base, and put it in num
 // Returns 1 on success, 0 otherwise. In any case charbufidx will be advanced
 static int sgeti(const char * buf, size_t bufsz, int * charbufidx, int64_t * num, int base);
 static int sgetu(const char * buf, size_t bufsz, int * charbufidx, uint64_t * num, int base);
 
-// Acts like snprintf, but cheats where it can get away with it to only support the calls Doom uses.
-// This is NOT a complete snprintf implementation, you WILL run into bugs if you use this expecting it to work like snprintf in the stdlibs
-// Based on the xv6 kernel's printf implementation
-// TODO: Doom uses these special format strings which xv6 does not support the extra modifiers
-// "STCFN%.3d"
-// "CWILV%2.2d"
-// "WIA%d%.2d%.2d"
+// Conversion flags
+#define FL_LEFT  1 // '-': pad on the right
+#define FL_ZERO  2 // '0': pad numbers with zeros
+#define FL_PLUS  4 // '+': always print a sign
+#define FL_SPACE 8 // ' ': space where a + would go
+#define FL_ALT   16 // '#': 0x before hex
+#define FL_UPPER 32 // upper case hex digits
+
 int snprintf(char * buf, size_t bufsz, const char * restrict format, ... ) {
 	va_list va; // varargs info
+	int n;
 	va_start(va, format); // initialise the varargs
-	vsnprintf(buf,bufsz,format,va);
+	n = vsnprintf(buf,bufsz,format,va);
 	va_end(va);
-	return 0;
+	return n;
 }
 
-// Acts like vsnprintf, same caveats as above
+// Acts like vsnprintf, in one pass over the format string.
+// Supports the flags "-0+ #", width and precision (either may be *), the length modifiers
+// hh h l ll z j t, and the conversions d i u x X o c s p %. There is no floating point.
+// Returns the length the output would have had, not counting the null terminator.
 int vsnprintf(char * buf, size_t bufsz, const char * restrict format, va_list va) {
-	// printf("snprintf called: format: \"%s\", bufsize: %d\n",format,bufsz);
-	int bufidx = 0; // index into buf, bufidx < bufsz
-	int formatidx = 0; // index into format, should stop at the null char
-	// trigger special cases
-	if (strcmp(format,"STCFN%.3d") == 0) {
-		snputs(buf,bufsz,&bufidx,"STCFN");
-		int64_t arg = va_arg(va,int64_t);
-		if (arg < 100) snputc(buf,bufsz,&bufidx,'0');
-		if (arg < 10) snputc(buf,bufsz,&bufidx,'0');
-		snputi(buf,bufsz,&bufidx,arg,10);
-		return 0;
-	}
-	if (strcmp(format,"CWILV%2.2d") == 0) {
-		snputs(buf,bufsz,&bufidx,"CWILV");
-		int64_t arg = va_arg(va,int64_t);
-		if (arg < 10) snputc(buf,bufsz,&bufidx,'0');
-		snputi(buf,bufsz,&bufidx,arg,10);
-		return 0;
-	}
-	if (strcmp(format,"WIA%d%.2d%.2d") == 0) {
-		snputs(buf,bufsz,&bufidx,"WIA");
-		int64_t arg1 = va_arg(va,int64_t);
-		snputi(buf,bufsz,&bufidx,arg1,10);
-
-		int64_t arg2 = va_arg(va,int64_t);
-		if (arg2 < 10) snputc(buf,bufsz,&bufidx,'0');
-		snputi(buf,bufsz,&bufidx,arg2,10);
-
-		int64_t arg3 = va_arg(va,int64_t);
-		if (arg3 < 10) snputc(buf,bufsz,&bufidx,'0');
-		snputi(buf,bufsz,&bufidx,arg3,10);
-		return 0;
-	}
-	// walk the format string
-	for (formatidx = 0; format[formatidx] != '\0'; formatidx++) {
-		// get current char in format string
-		char c = format[formatidx];
-		if (c == '%') {
-			// if '%', special handling
-			formatidx++;
-			char f = format[formatidx];
-			if (f == '\0') {
-				// string null terminator
-				break;
-			}
-			switch (f) {
-				case 'd':
-				case 'i':
-					// Integer
-					{
-						int64_t strint = va_arg(va,int64_t);
-						snputi(buf,bufsz,&bufidx,strint,10);
-					}
-					break;
-				case 'x':
-					// Hex integer
-					{
-						uint64_t strxint = va_arg(va,uint64_t);
-						snputu(buf,bufsz,&bufidx,strxint,16);
-					}
-					break;
-				case 'p':
-					// Pointer
-					{
-						void * strptr = va_arg(va,void *);
-						snputptr(buf,bufsz,&bufidx,strptr);
-					}
-					break;
-				case 's':
-					// String
-					{
-						char * strarg = va_arg(va,char *);
-						snputs(buf,bufsz,&bufidx,strarg);
-					}
-					break;
-				case '%':
-					// Literal %
-					snputc(buf,bufsz,&bufidx,'%');
-					break;
-				default:
-					// We don't know this one
-					printf("snprintf: illegal placeholder ASCII%d in format string '%s' \n",f,format);
-					// Kill the program
-					exit(-1);
-					return 0;
+	int bufidx = 0; // chars output so far, may run past bufsz
+	const char * f;
+	for (f = format; *f != '\0'; f++) {
+		if (*f != '%') {
+			// normal character, just buffer it
+			snputc(buf,bufsz,&bufidx,*f);
+			continue;
+		}
+		f++;
+		// flags
+		int flags = 0;
+		for (;; f++) {
+			if (*f == '-') flags |= FL_LEFT;
+			else if (*f == '0') flags |= FL_ZERO;
+			else if (*f == '+') flags |= FL_PLUS;
+			else if (*f == ' ') flags |= FL_SPACE;
+			else if (*f == '#') flags |= FL_ALT;
+			else break;
+		}
+		// width
+		int width = 0;
+		if (*f == '*') {
+			width = va_arg(va,int);
+			if (width < 0) {
+				flags |= FL_LEFT;
+				width = -width;
 			}
+			f++;
 		} else {
-			// normal character, just buffer it
-			snputc(buf,bufsz,&bufidx,c);
+			while (isdigit(*f)) width = 10 * width + ctoi(*f++);
+		}
+		// precision, -1 if none
+		int prec = -1;
+		if (*f == '.') {
+			f++;
+			prec = 0;
+			if (*f == '*') {
+				prec = va_arg(va,int);
+				f++;
+			} else {
+				while (isdigit(*f)) prec = 10 * prec + ctoi(*f++);
+			}
+		}
+		// length: 1 for long and wider, -1 for short, -2 for char
+		int len = 0;
+		if (*f == 'h') {
+			len = -1;
+			if (*++f == 'h') { len = -2; f++; }
+		} else if (*f == 'l') {
+			len = 1;
+			if (*++f == 'l') f++;
+		} else if (*f == 'z' || *f == 'j' || *f == 't') {
+			len = 1;
+			f++;
+		}
+		int64_t snum;
+		uint64_t unum;
+		switch (*f) {
+			case 'd':
+			case 'i':
+				// Integer
+				snum = len > 0 ? va_arg(va,int64_t) : va_arg(va,int);
+				if (len == -1) snum = (short) snum;
+				if (len == -2) snum = (signed char) snum;
+				unum = snum < 0 ? -(uint64_t)snum : (uint64_t)snum;
+				snputnum(buf,bufsz,&bufidx,unum,snum < 0,10,prec,width,flags);
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				// Unsigned integer
+				unum = len > 0 ? va_arg(va,uint64_t) : va_arg(va,uint);
+				if (len == -1) unum = (ushort) unum;
+				if (len == -2) unum = (uchar) unum;
+				if (*f == 'X') flags |= FL_UPPER;
+				flags &= ~(FL_PLUS | FL_SPACE);
+				snputnum(buf,bufsz,&bufidx,unum,0,*f == 'u' ? 10 : *f == 'o' ? 8 : 16,prec,width,flags);
+				break;
+			case 'p':
+				// Pointer, as all 16 hex digits
+				unum = (uint64_t) va_arg(va,void *);
+				snputnum(buf,bufsz,&bufidx,unum,0,16,16,width,(flags & FL_LEFT) | FL_ALT);
+				break;
+			case 's':
+				// String
+				snputs(buf,bufsz,&bufidx,va_arg(va,char *),prec,width,flags);
+				break;
+			case 'c':
+				// Character
+				if (!(flags & FL_LEFT)) snpad(buf,bufsz,&bufidx,' ',width - 1);
+				snputc(buf,bufsz,&bufidx,va_arg(va,int));
+				if (flags & FL_LEFT) snpad(buf,bufsz,&bufidx,' ',width - 1);
+				break;
+			case '%':
+				// Literal %
+				snputc(buf,bufsz,&bufidx,'%');
+				break;
+			case '\0':
+				// string null terminator
+				f--;
+				break;
+			default:
+				// We don't know this one
+				printf("snprintf: illegal placeholder ASCII%d in format string '%s' \n",*f,format);
+				// Kill the program
+				exit(-1);
+				return 0;
 		}
-		
 	}
-	snputc(buf,bufsz,&bufidx,'\0'); // Null terminator
-	return 0;
+	// Null terminator, in the last byte if the output did not fit
+	if (bufsz > 0) buf[(size_t)bufidx < bufsz ? (size_t)bufidx : bufsz - 1] = '\0';
+	return bufidx;
 }
 
 static void snputc(char * buf, size_t bufsz, int * charbufidx, int ch) { // assist for the above
-	if (*charbufidx < bufsz) {
+	if ((size_t)*charbufidx + 1 < bufsz) {
 		buf[*charbufidx] = ch;
-		(*charbufidx)++;
 	}
+	(*charbufidx)++;
 }
 
-static void snputs(char * buf, size_t bufsz, int * charbufidx, const char * str) { // assist for the above
-	uint i;
-	uint len = strlen(str);
-	for (i = 0; i < len; i++) {
-		snputc(buf,bufsz,charbufidx,str[i]);
+static void snpad(char * buf, size_t bufsz, int * charbufidx, int ch, int n) { // assist for the above
+	while (n-- > 0) snputc(buf,bufsz,charbufidx,ch);
+}
+
+// Put at most prec (if not negative) chars of str, padded with spaces to width
+static void snputs(char * buf, size_t bufsz, int * charbufidx, const char * str, int prec, int width, int flags) {
+	int len;
+	if (str == NULL) str = "(null)";
+	if (prec < 0) {
+		len = strlen(str);
+	} else {
+		const char * end = memchr(str,'\0',prec);
+		len = end ? end - str : prec;
+	}
+	if (!(flags & FL_LEFT)) snpad(buf,bufsz,charbufidx,' ',width - len);
+	if ((size_t)*charbufidx + len < bufsz) {
+		// fits, copy it in one go
+		memmove(buf + *charbufidx,str,len);
+		*charbufidx += len;
+	} else {
+		int i;
+		for (i = 0; i < len; i++) snputc(buf,bufsz,charbufidx,str[i]);
 	}
+	if (flags & FL_LEFT) snpad(buf,bufsz,charbufidx,' ',width - len);
 }
 
 static const char * digits = "0123456789abcdef";
 static const char * digits2 = "0123456789ABCDEF";
 
-static void snputi(char * buf, size_t bufsz, int * charbufidx, int64_t num, int base) {
+// Put the number with magnitude mag, negative if neg, with at least prec digits, padded to width
+static void snputnum(char * buf, size_t bufsz, int * charbufidx, uint64_t mag, int neg, int base, int prec, int width, int flags) {
 	// Numbers have to be generated in a stack since we only can peel off the bottom
-	char numbuf[32];
+	char numbuf[24];
 	int numbufidx = 0;
-	int64_t n = num;
-	int negative = n < 0; // if true, append - to end
-	// peel and buffer
-	do {
-		numbuf[numbufidx] = digits[abs(n % base)];
-		numbufidx++;
-		n = n / base;
-	} while (n > 0);
-
-	if (negative) {
-		numbuf[numbufidx] = '-';
-		numbufidx++;
+	const char * dig = (flags & FL_UPPER) ? digits2 : digits;
+	char prefix[3];
+	int prefixlen = 0;
+	int zeros, pad;
+	// peel and buffer; a precision of 0 prints nothing for 0
+	while (mag != 0 || (numbufidx == 0 && prec != 0)) {
+		numbuf[numbufidx++] = dig[mag % base];
+		mag /= base;
 	}
-	// now pop the stack
-	while (numbufidx > 0) {
-		numbufidx--;
-		snputc(buf,bufsz,charbufidx,numbuf[numbufidx]);
+	if (neg) prefix[prefixlen++] = '-';
+	else if (flags & FL_PLUS) prefix[prefixlen++] = '+';
+	else if (flags & FL_SPACE) prefix[prefixlen++] = ' ';
+	if ((flags & FL_ALT) && base == 16) {
+		prefix[prefixlen++] = '0';
+		prefix[prefixlen++] = (flags & FL_UPPER) ? 'X' : 'x';
 	}
-}
-
-static void snputu(char * buf, size_t bufsz, int * charbufidx, uint64_t num, int base) {
-	// Unsigned version
-	// Numbers have to be generated in a stack since we only can peel off the bottom
-	char numbuf[32];
-	int numbufidx = 0;
-	uint64_t n = num;
-	// peel and buffer
-	do {
-		numbuf[numbufidx] = digits[n % base];
-		numbufidx++;
-		n = n / base;
-	} while (n > 0);
-	// now pop the stack
-	while (numbufidx > 0) {
-		numbufidx--;
-		snputc(buf,bufsz,charbufidx,numbuf[numbufidx]);
-	}
-}
-
-static void snputptr(char * buf, size_t bufsz, int * charbufidx, void * ptr) { // assist for the above
-	uint64 ptrval = (uint64) ptr;
-	snputc(buf,bufsz,charbufidx,'0');
-	snputc(buf,bufsz,charbufidx,'x');
-	int i;
-	for (i = 0; i < 16; i++) { // 16 digits in a 64 bit value
-		snputc(buf,bufsz,charbufidx,digits[(ptrval >> ((15 - i) * 4)) & 0xF]);
+	zeros = prec > numbufidx ? prec - numbufidx : 0;
+	pad = width - prefixlen - zeros - numbufidx;
+	if ((flags & (FL_ZERO | FL_LEFT)) == FL_ZERO && prec < 0 && pad > 0) {
+		// zero padding goes after the sign
+		zeros += pad;
+		pad = 0;
 	}
+	if (!(flags & FL_LEFT)) snpad(buf,bufsz,charbufidx,' ',pad);
+	snputs(buf,bufsz,charbufidx,prefix,prefixlen,0,0);
+	snpad(buf,bufsz,charbufidx,'0',zeros);
+	// now pop the stack
+	while (numbufidx > 0) snputc(buf,bufsz,charbufidx,numbuf[--numbufidx]);
+	if (flags & FL_LEFT) snpad(buf,bufsz,charbufidx,' ',pad);
 }
 
 // Acts like sscanf, but cheats, only supporting the calls Doom uses.
@@ -346,49 +372,47 @@ static int sgetu(const char * buf, size_t bufsz, int * charbufidx, uint64_t * nu
 	return 1;
 }
 
-// like ctoi but works with hex digits too at cost of speed
+// like ctoi but works with hex digits too
 static int ctoix(int c) {
-	uint digitslen = strlen(digits2);
-	size_t i;
-	for (i = 0; i < digitslen; i++) {
-		if (digits2[i] == toupper(c)) return (int) i;
-	}
+	if (isdigit(c)) return c - '0';
+	if (isxdigit(c)) return (c | 0x20) - 'a' + 10;
 	return 0;
 }
 
 // string.h
 
+// Character classes, looked up by unsigned char
+#define CT_SPACE  1
+#define CT_DIGIT  2
+#define CT_XDIGIT 4
+#define CT_LOWER  8
+
+static const uchar ctype[256] = {
+	['\t'] = CT_SPACE, ['\n'] = CT_SPACE, ['\v'] = CT_SPACE,
+	['\f'] = CT_SPACE, ['\r'] = CT_SPACE, [' '] = CT_SPACE,
+	['0' ... '9'] = CT_DIGIT | CT_XDIGIT,
+	['A' ... 'F'] = CT_XDIGIT,
+	['a' ... 'f'] = CT_LOWER | CT_XDIGIT,
+	['g' ... 'z'] = CT_LOWER,
+};
+
+// toupper() without the call, for the comparisons below
+#define TOUPPER(c) ((uchar)(c) - ((ctype[(uchar)(c)] & CT_LOWER) ? 0x20 : 0))
+
 int isspace(int c) {
-	// 0x09 - horizontal tab
-	// 0x20 - space
-	// 0x0A - linefeed
-	// 0x0B - vertical tab
-	// 0x0C - form feed
-	// 0x0D - carriage return
-	return c == 0x09 || c == 0x20 || c == 0x0A || c == 0x0B || c == 0x0C || c == 0x0D;
+	return ctype[(uchar)c] & CT_SPACE;
 }
 
 int isdigit(int c) {
-	return '0' <= c && c <= '9'; // ASCII abuse
+	return ctype[(uchar)c] & CT_DIGIT;
 }
 
 int isxdigit(int c) {
-	uint digitslen = strlen(digits2);
-	size_t i;
-	for (i = 0; i < digitslen; i++) {
-		if (digits2[i] == toupper(c)) return 1;
-	}
-	return 0;
+	return ctype[(uchar)c] & CT_XDIGIT;
 }
 
 int toupper(int c) {
-	if (c >= 0x61 && c <= 0x7A) {
-		// in lowercase range
-		// subtract hex 0x20 to get into uppercase range
-		return c - 0x20;
-	}
-	// do nothing otherwise
-	return c;
+	return TOUPPER(c);
 }
 
 char * strdup(const char * str) {
@@ -439,36 +463,40 @@ int strncmp(const char * lhs, const char * rhs, size_t sz) {
 int strncasecmp(const char * lhs, const char * rhs, size_t sz) {
 	if (sz == 0) return 0;
 	size_t i = 0;
-	while (lhs[i] != '\0' && toupper(lhs[i]) == toupper(rhs[i]) && i < sz - 1) i++;
-	return (unsigned char)toupper(lhs[i]) - (unsigned char)toupper(rhs[i]);
+	while (lhs[i] != '\0' && TOUPPER(lhs[i]) == TOUPPER(rhs[i]) && i < sz - 1) i++;
+	return TOUPPER(lhs[i]) - TOUPPER(rhs[i]);
 }
 int strcasecmp(const char * lhs, const char * rhs) {
 	size_t i = 0;
-	while (lhs[i] != '\0' && toupper(lhs[i]) == toupper(rhs[i])) i++;
-	return (unsigned char)toupper(lhs[i]) - (unsigned char)toupper(rhs[i]);
+	while (lhs[i] != '\0' && TOUPPER(lhs[i]) == TOUPPER(rhs[i])) i++;
+	return TOUPPER(lhs[i]) - TOUPPER(rhs[i]);
 }
 
+// Boyer-Moore-Horspool: on a mismatch, shift the needle by how far the haystack char under
+// its last position is from the needle's end. Short needles and haystacks aren't worth the
+// shift table; look for the first char with memchr() and compare from there.
 char * strstr(const char * str, const char * substr) {
-	uint strl = strlen(str);
-	uint substrl = strlen(substr);
+	size_t strl = strlen(str);
+	size_t substrl = strlen(substr);
 	if (substrl == 0) return (char *) str; // empty search string always succeeds
 	if (substrl > strl) return NULL; // search string longer than haystack string, always fails
-	size_t hayidx;
-	size_t needleidx;
-	// search all positions that are searchable
-	// str 3, needle 2 = pos 0 1
-	// str 5, needle 3 = pos 0 1 2
-	for (hayidx = 0; hayidx <= strl - substrl; hayidx++) {
-		// iterate the needle string indices
-		for (needleidx = 0; needleidx < substrl; needleidx++) {
-			// if mismatch, continue outer loop
-			if (str[hayidx + needleidx] != substr[needleidx]) {
-				goto continue_outer;
-			}
+	const char * end = str + strl - substrl; // last place the needle could start
+	if (substrl < 4 || strl < 64 || substrl > 0xffff) {
+		const char * p = str;
+		while ((p = memchr(p,substr[0],end - p + 1)) != NULL) {
+			if (memcmp(p,substr,substrl) == 0) return (char *) p;
+			p++;
 		}
-		// if we get here, we iterated the whole substring; success
-		return (char *) &str[hayidx];
-		continue_outer: {} // block here to make compiler happy
+		return NULL;
+	}
+	ushort shift[256];
+	size_t i;
+	for (i = 0; i < 256; i++) shift[i] = substrl;
+	for (i = 0; i < substrl - 1; i++) shift[(uchar)substr[i]] = substrl - 1 - i;
+	uchar last = substr[substrl - 1];
+	const char * p;
+	for (p = str; p <= end; p += shift[(uchar)p[substrl - 1]]) {
+		if ((uchar)p[substrl - 1] == last && memcmp(p,substr,substrl - 1) == 0) return (char *) p;
 	}
 	// no success
 	return NULL;
@@ -549,35 +577,3 @@ int abs(int x) {
 	if (x < 0) return -x;
 	return x;
 }
-
-// Taken from umalloc.c
-// This is an ugly hack to get at the block size
-// Don't do this
-
-union header {
-  	struct {
-    	union header *ptr;
-    	uint size;
-  	} s;
-	long x;
-};
-
-void * realloc(void * ptr, size_t newsz) {
-	// UGLY HACK
-	union header * alloc_header = (union header *)ptr - 1;
-	uint oldsz = alloc_header->s.size;
-	// END UGLY HACK
-	char * newblk = malloc(newsz);
-	if (newblk == NULL) return NULL;
-	memmove(newblk,ptr,oldsz);
-	free(ptr);
-	return (void *) newblk;
-}
-void * calloc(size_t num, size_t size) {
-	size_t blksz = num * size;
-	// check overflow of blksz
-	char * blk = malloc(blksz);
-	if (blk == NULL) return NULL;
-	memset(blk,0,blksz);
-	return blk;
-}
\ No newline at end of file
@@ -42,6 +42,4 @@ double atof(const char * str);
 
 // stdlib.h
 int abs(int x);
-void * realloc(void * ptr, size_t newsz);
-void * calloc(size_t num, size_t size);
 #endif
\ No newline at end of file
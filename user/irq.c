@@ -0,0 +1,59 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// Show device interrupt routing and counts, or change which
+// harts take a device's interrupts.
+//
+//   irq              list each device's IRQ, harts, and counts
+//   irq n mask       route IRQ n to the harts in mask, e.g. 0x6
+//                    for harts 1 and 2
+
+struct {
+  int irq;
+  char *name;
+} devs[] = {
+  { UART0_IRQ, "uart" },
+  { VIRTIO0_IRQ, "disk" },
+  { VIRTIO1_IRQ, "gpu" },
+  { VIRTIO2_IRQ, "kbd" },
+  { VIRTIO3_IRQ, "snd" },
+};
+
+int
+main(int argc, char *argv[])
+{
+  uint64 counts[NCPU], mask;
+  int i, j, irq;
+
+  if(argc == 3){
+    irq = atoi(argv[1]);
+    mask = atoix(argv[2]);
+    if(mask == 0 || irqaffinity(irq, mask) == -1){
+      fprintf(2, "irq: cannot route irq %d to harts %x\n", irq, (int)mask);
+      exit(1);
+    }
+    exit(0);
+  }
+  if(argc != 1){
+    fprintf(2, "usage: irq [n mask]\n");
+    exit(1);
+  }
+
+  printf("irq dev  harts");
+  for(j = 0; j < NCPU; j++)
+    printf("  hart%d", j);
+  printf("\n");
+  for(i = 0; i < sizeof(devs)/sizeof(devs[0]); i++){
+    irq = devs[i].irq;
+    if(irqstat(irq, counts) < 0)
+      continue;
+    printf("%d   %s  %x", irq, devs[i].name, (int)irqaffinity(irq, 0));
+    for(j = 0; j < NCPU; j++)
+      printf("  %l", counts[j]);
+    printf("\n");
+  }
+  exit(0);
+}
@@ -0,0 +1,37 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+// Print spinlock contention, by lock name, most time spent
+// waiting first. Needs a kernel built with make LOCKSTAT=1.
+
+#define NSTAT 64
+
+struct lockstat stats[NSTAT];
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat t;
+  int i, j, n;
+
+  n = lockstat(stats, NSTAT);
+  if(n < 0){
+    fprintf(2, "lockstat: kernel built without LOCKSTAT\n");
+    exit(1);
+  }
+
+  for(i = 1; i < n; i++){
+    t = stats[i];
+    for(j = i; j > 0 && stats[j-1].spincycles < t.spincycles; j--)
+      stats[j] = stats[j-1];
+    stats[j] = t;
+  }
+
+  printf("name\tacquired\tcontended\tspin cycles\n");
+  for(i = 0; i < n; i++)
+    printf("%s\t%l\t%l\t%l\n", stats[i].name, stats[i].nacquire,
+           stats[i].ncontended, stats[i].spincycles);
+  exit(0);
+}
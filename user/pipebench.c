@@ -0,0 +1,75 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Measure pipe throughput: a child writes TOTAL bytes through a
+// pipe in chunks of each size, and the parent reads them.
+//
+//   pipebench [pipesize]
+//
+// pipesize is passed to pipe2(); 0, the default, gives the
+// kernel's default pipe size.
+
+#define TOTAL (8*1024*1024)
+#define MAXCHUNK 65536
+
+char buf[MAXCHUNK];
+
+// returns bytes per second.
+static uint64
+run(int pipesize, int chunk)
+{
+  int fds[2], pid, n, total;
+  uint64 t0, t1;
+
+  if(pipe2(fds, pipesize) < 0){
+    fprintf(2, "pipebench: pipe2 %d failed\n", pipesize);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "pipebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(total = 0; total < TOTAL; total += chunk)
+      if(write(fds[1], buf, chunk) != chunk)
+        exit(1);
+    exit(0);
+  }
+
+  close(fds[1]);
+  t0 = nanotime();
+  total = 0;
+  while((n = read(fds[0], buf, chunk)) > 0)
+    total += n;
+  t1 = nanotime();
+  close(fds[0]);
+  wait(0);
+  if(total != TOTAL){
+    fprintf(2, "pipebench: read %d of %d bytes\n", total, TOTAL);
+    exit(1);
+  }
+  return (uint64)TOTAL * 1000000000 / (t1 - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static int chunks[] = { 512, 4096, MAXCHUNK };
+  int pipesize = 0;
+
+  if(argc > 2){
+    fprintf(2, "usage: pipebench [pipesize]\n");
+    exit(1);
+  }
+  if(argc == 2)
+    pipesize = atoi(argv[1]);
+
+  for(int i = 0; i < sizeof(chunks)/sizeof(chunks[0]); i++){
+    printf("pipe %d chunk %d: %l KB/s\n", pipesize, chunks[i],
+           run(pipesize, chunks[i]) / 1024);
+  }
+  exit(0);
+}
@@ -1,19 +1,83 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
 #include "user/user.h"
 
 #include <stdarg.h>
 
 static char digits[] = "0123456789ABCDEF";
 
+// Output is collected in a buffer per fd and written with one
+// system call, rather than one per character. Output to a device,
+// such as the console, goes out at the end of each printf() call,
+// so that prompts without a newline show up. Other output goes
+// out when its buffer fills, at fflush(), and at close(), fork(),
+// exec() and exit(). Threads that print to the same fd at once may
+// garble each other's output.
+#define PRINTBUFSZ 512
+
+struct printbuf {
+  int fd;
+  int mode;   // 0 if not yet known, else PB_LINE or PB_FULL
+  int n;      // bytes in buf
+  char buf[PRINTBUFSZ];
+};
+
+#define PB_LINE 1  // device: write out at the end of each call
+#define PB_FULL 2  // file or pipe: write out when full
+
+static struct printbuf pbufs[NOFILE];
+
+static void
+flushbuf(struct printbuf *b)
+{
+  int n = b->n;
+
+  b->n = 0;
+  if(n > 0 && n <= PRINTBUFSZ)
+    write(b->fd, b->buf, n);
+}
+
+// write out fd's buffered output, or every fd's if fd is -1.
+// ulib.c calls this through printflush, before close(), fork(),
+// exec() and exit().
+static void
+flushfd(int fd)
+{
+  int i;
+
+  for(i = 0; i < NOFILE; i++){
+    if(fd == -1 || fd == i){
+      flushbuf(&pbufs[i]);
+      // fd may be opened as something else next.
+      if(fd != -1)
+        pbufs[i].mode = 0;
+    }
+  }
+}
+
+void
+fflush(int fd)
+{
+  if(fd >= 0 && fd < NOFILE)
+    flushbuf(&pbufs[fd]);
+}
+
 static void
-putc(int fd, char c)
+putc(struct printbuf *b, char c)
 {
-  write(fd, &c, 1);
+  int n = b->n;
+
+  if(n < 0 || n >= PRINTBUFSZ){
+    flushbuf(b);
+    n = 0;
+  }
+  b->buf[n] = c;
+  b->n = n + 1;
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(struct printbuf *b, int xx, int base, int sgn)
 {
   char buf[16];
   int i, neg;
@@ -35,21 +99,20 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(b, buf[i]);
 }
 
 static void
-printptr(int fd, uint64 x) {
+printptr(struct printbuf *b, uint64 x) {
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+  putc(b, '0');
+  putc(b, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(b, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the given fd. Only understands %d, %x, %p, %s.
-void
-vprintf(int fd, const char *fmt, va_list ap)
+static void
+vbprintf(struct printbuf *b, const char *fmt, va_list ap)
 {
   char *s;
   int c, i, state;
@@ -61,39 +124,66 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        putc(b, c);
       }
     } else if(state == '%'){
       if(c == 'd' || c == 'i'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(b, va_arg(ap, int), 10, 1);
       } else if(c == 'l') {
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(b, va_arg(ap, uint64), 10, 0);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(b, va_arg(ap, int), 16, 0);
       } else if(c == 'p') {
-        printptr(fd, va_arg(ap, uint64));
+        printptr(b, va_arg(ap, uint64));
       } else if(c == 's'){
         s = va_arg(ap, char*);
         if(s == 0)
           s = "(null)";
         while(*s != 0){
-          putc(fd, *s);
+          putc(b, *s);
           s++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        putc(b, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        putc(b, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(b, '%');
+        putc(b, c);
       }
       state = 0;
     }
   }
 }
 
+// Print to the given fd. Only understands %d, %x, %p, %s.
+void
+vprintf(int fd, const char *fmt, va_list ap)
+{
+  struct printbuf *b, tmp;
+  struct stat st;
+
+  if(fd < 0 || fd >= NOFILE){
+    // not an fd we keep a buffer for; write it out right away.
+    tmp.fd = fd;
+    tmp.mode = PB_LINE;
+    tmp.n = 0;
+    b = &tmp;
+  } else {
+    b = &pbufs[fd];
+    if(b->mode == 0){
+      b->fd = fd;
+      b->mode = fstat(fd, &st) == 0 && st.type != T_DEVICE ? PB_FULL : PB_LINE;
+      printflush = flushfd;
+    }
+  }
+
+  vbprintf(b, fmt, ap);
+  if(b->mode == PB_LINE)
+    flushbuf(b);
+}
+
 void
 fprintf(int fd, const char *fmt, ...)
 {
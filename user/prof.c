@@ -0,0 +1,93 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/poll.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+// Run a command with the profiler on and save every hart's
+// samples to a file, for tools/profsym.py to make sense of.
+//
+//   prof [-f hz] file cmd [arg...]
+//
+// samples at 1000 Hz unless -f says otherwise. Samples from
+// other processes are kept too; profsym.py can filter by pid.
+
+#define NBUF 64
+
+static struct profsample buf[NBUF];
+
+// Move buffered samples into fd. Returns how many.
+static int
+drain(int fd)
+{
+  int n, total = 0;
+
+  while((n = profread(buf, NBUF)) > 0){
+    if(write(fd, buf, n * sizeof(buf[0])) != n * sizeof(buf[0])){
+      fprintf(2, "prof: write failed\n");
+      exit(1);
+    }
+    total += n;
+  }
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pollfd pfd;
+  int hz = 1000, fd, p[2], pid, nsample = 0, dropped;
+
+  if(argc > 2 && strcmp(argv[1], "-f") == 0){
+    hz = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 3){
+    fprintf(2, "usage: prof [-f hz] file cmd [arg...]\n");
+    exit(1);
+  }
+
+  if((fd = open(argv[1], O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    fprintf(2, "prof: cannot open %s\n", argv[1]);
+    exit(1);
+  }
+  // the child holds the write end, so it hangs up when cmd exits.
+  if(pipe(p) < 0){
+    fprintf(2, "prof: pipe failed\n");
+    exit(1);
+  }
+  if(profctl(hz) < 0){
+    fprintf(2, "prof: bad rate %d\n", hz);
+    exit(1);
+  }
+
+  if((pid = fork()) < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p[0]);
+    close(fd);
+    exec(argv[2], argv + 2);
+    fprintf(2, "prof: exec %s failed\n", argv[2]);
+    exit(1);
+  }
+  close(p[1]);
+
+  pfd.fd = p[0];
+  pfd.events = POLLIN;
+  for(;;){
+    nsample += drain(fd);
+    // 20ms is well inside what a hart's buffer holds at 1000 Hz.
+    if(poll(&pfd, 1, 20000000) < 0 || (pfd.revents & POLLHUP))
+      break;
+  }
+
+  dropped = profctl(0);
+  nsample += drain(fd);
+  wait(0);
+  close(fd);
+  printf("prof: %d samples, %d dropped, in %s\n", nsample, dropped, argv[1]);
+  exit(0);
+}
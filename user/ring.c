@@ -0,0 +1,69 @@
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+// User side of the system call rings; see kernel/ring.h.
+//
+//   struct ring *r = ringinit(0);
+//   struct sqe *e = ringsqe(r);
+//   e->op = RING_WRITE; e->fd = 1; e->addr = (uint64)buf; e->len = n;
+//   ringsubmit(r);
+//   struct cqe *c = ringcqe(r);  // c->res is write()'s result
+//   ringcqseen(r);
+
+// Map the calling process's rings, with RING_* flags.
+// Returns 0 if it already has them, or on failure.
+struct ring*
+ringinit(int flags)
+{
+  uint64 va = (uint64)ringsetup(flags);
+
+  if(va == -1)
+    return 0;
+  return (struct ring*)va;
+}
+
+// The next free submission, cleared, to be filled in and
+// handed over by ringsubmit(). Returns 0 if the ring is full.
+struct sqe*
+ringsqe(struct ring *r)
+{
+  struct sqe *e;
+
+  if(r->sqnext - r->sqhead >= NRING)
+    return 0;
+  e = &r->sq[r->sqnext++ % NRING];
+  memset(e, 0, sizeof(*e));
+  return e;
+}
+
+// Hand the kernel every submission from ringsqe() so far.
+// Without RING_SQPOLL, also trap so it performs them now.
+// Returns how many the kernel performed, or -1.
+int
+ringsubmit(struct ring *r)
+{
+  __sync_synchronize();
+  r->sqtail = r->sqnext;
+  if(r->flags & RING_SQPOLL)
+    return 0;
+  return ringenter(0);
+}
+
+// The oldest unseen completion, or 0 if there is none.
+struct cqe*
+ringcqe(struct ring *r)
+{
+  __sync_synchronize();
+  if(r->cqhead == r->cqtail)
+    return 0;
+  return &r->cq[r->cqhead % NRING];
+}
+
+// Done with the completion ringcqe() returned.
+void
+ringcqseen(struct ring *r)
+{
+  __sync_synchronize();
+  r->cqhead++;
+}
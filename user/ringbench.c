@@ -0,0 +1,99 @@
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+// Compare the cost of small system calls made one trap at a
+// time with the same calls batched through the system call rings.
+//
+//   ringbench [batch]
+//
+// batch is how many submissions go in before each ringsubmit(),
+// at most NRING; the default is 32.
+
+#define N 8192
+
+static struct ring *r;
+static char buf[N];
+
+static void
+check(struct cqe *c, uint64 want, char *what)
+{
+  if(c == 0 || c->res != want){
+    fprintf(2, "ringbench: bad %s completion\n", what);
+    exit(1);
+  }
+}
+
+// N ops, in batches; returns nanoseconds per op.
+static uint64
+ringrun(int op, int fd, int batch)
+{
+  struct sqe *e;
+  uint64 t0;
+  int i, j;
+
+  t0 = nanotime();
+  for(i = 0; i < N; i += batch){
+    for(j = 0; j < batch && i + j < N; j++){
+      e = ringsqe(r);
+      e->op = op;
+      e->fd = fd;
+      e->addr = (uint64)buf + i + j;
+      e->len = 1;
+    }
+    ringsubmit(r);
+    while(j-- > 0){
+      check(ringcqe(r), op == RING_NOP ? 0 : 1, "ring");
+      ringcqseen(r);
+    }
+  }
+  return (nanotime() - t0) / N;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], batch = 32, i;
+  uint64 t0, sys, ring;
+
+  if(argc > 2){
+    fprintf(2, "usage: ringbench [batch]\n");
+    exit(1);
+  }
+  if(argc == 2)
+    batch = atoi(argv[1]);
+  if(batch < 1 || batch > NRING){
+    fprintf(2, "ringbench: batch must be 1..%d\n", NRING);
+    exit(1);
+  }
+  if((r = ringinit(0)) == 0 || pipe2(fds, 2*N) < 0){
+    fprintf(2, "ringbench: setup failed\n");
+    exit(1);
+  }
+
+  // a system call that does nothing, against a ring nop.
+  t0 = nanotime();
+  for(i = 0; i < N; i++)
+    getpid();
+  sys = (nanotime() - t0) / N;
+  ring = ringrun(RING_NOP, 0, batch);
+  printf("nop: syscall %l ns, ring %l ns\n", sys, ring);
+
+  // one-byte writes into a pipe big enough for all of them,
+  // then one-byte reads back out.
+  t0 = nanotime();
+  for(i = 0; i < N; i++)
+    write(fds[1], buf + i, 1);
+  sys = (nanotime() - t0) / N;
+  ring = ringrun(RING_WRITE, fds[1], batch);
+  printf("write: syscall %l ns, ring %l ns\n", sys, ring);
+
+  t0 = nanotime();
+  for(i = 0; i < N; i++)
+    read(fds[0], buf + i, 1);
+  sys = (nanotime() - t0) / N;
+  ring = ringrun(RING_READ, fds[0], batch);
+  printf("read: syscall %l ns, ring %l ns\n", sys, ring);
+
+  exit(0);
+}
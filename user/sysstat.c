@@ -0,0 +1,161 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "kernel/syscall.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+// Show system calls, interrupts and idle time per second, taken
+// over an interval, busiest first.
+//
+//   sysstat [secs]
+//
+// counts over one second unless secs is given.
+
+static struct sysstat a, b;
+
+static char *names[NSYSCALL] = {
+[SYS_fork]        "fork",
+[SYS_exit]        "exit",
+[SYS_wait]        "wait",
+[SYS_pipe]        "pipe",
+[SYS_read]        "read",
+[SYS_kill]        "kill",
+[SYS_exec]        "exec",
+[SYS_fstat]       "fstat",
+[SYS_chdir]       "chdir",
+[SYS_dup]         "dup",
+[SYS_getpid]      "getpid",
+[SYS_sbrk]        "sbrk",
+[SYS_sleep]       "sleep",
+[SYS_uptime]      "uptime",
+[SYS_open]        "open",
+[SYS_write]       "write",
+[SYS_mknod]       "mknod",
+[SYS_unlink]      "unlink",
+[SYS_link]        "link",
+[SYS_mkdir]       "mkdir",
+[SYS_close]       "close",
+[SYS_gpucmd]      "gpucmd",
+[SYS_kbdcmd]      "kbdcmd",
+[SYS_setsched]    "setsched",
+[SYS_setaffinity] "setaffinity",
+[SYS_nanotime]    "nanotime",
+[SYS_nanosleep]   "nanosleep",
+[SYS_irqaffinity] "irqaffinity",
+[SYS_irqstat]     "irqstat",
+[SYS_lockstat]    "lockstat",
+[SYS_pipe2]       "pipe2",
+[SYS_clone]       "clone",
+[SYS_futex]       "futex",
+[SYS_poll]        "poll",
+[SYS_ringsetup]   "ringsetup",
+[SYS_ringenter]   "ringenter",
+[SYS_procstat]    "procstat",
+[SYS_profctl]     "profctl",
+[SYS_profread]    "profread",
+[SYS_perfctl]     "perfctl",
+[SYS_perfread]    "perfread",
+[SYS_tracectl]    "tracectl",
+[SYS_traceread]   "traceread",
+[SYS_sysstat]     "sysstat",
+[SYS_lseek]       "lseek",
+};
+
+static char *irqnames[NIRQ] = {
+[0]           "clock/ipi",
+[UART0_IRQ]   "uart",
+[VIRTIO0_IRQ] "disk",
+[VIRTIO1_IRQ] "gpu",
+[VIRTIO2_IRQ] "kbd",
+[VIRTIO3_IRQ] "snd",
+};
+
+// the latency, in us, that fraction pm/1000 of the n calls
+// in hist took no longer than: its bucket's upper bound.
+static uint64
+percentile(uint64 *hist, uint64 n, int pm)
+{
+  uint64 seen = 0;
+  int i;
+
+  for(i = 0; i < NLATBUCKET-1; i++){
+    seen += hist[i];
+    if(seen * 1000 >= n * pm)
+      break;
+  }
+  return 1L << i;
+}
+
+// print s as a 16-column wide first column.
+static void
+label(char *s)
+{
+  printf("%s\t", s ? s : "?");
+  if(s == 0 || strlen(s) < 8)
+    printf("\t");
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 t0, t1, ns, n, hist[NLATBUCKET];
+  int secs = 1, order[NSYSCALL], i, j, k, m;
+
+  if(argc > 2 || (argc == 2 && (secs = atoi(argv[1])) <= 0)){
+    fprintf(2, "usage: sysstat [secs]\n");
+    exit(1);
+  }
+
+  t0 = nanotime();
+  if(sysstat(&a) < 0){
+    fprintf(2, "sysstat: sysstat failed\n");
+    exit(1);
+  }
+  nanosleep(secs * 1000000000L);
+  t1 = nanotime();
+  sysstat(&b);
+  ns = t1 - t0;
+
+  // insertion sort, most calls first.
+  m = 0;
+  for(i = 1; i < NSYSCALL; i++){
+    if(b.sys[i].count == a.sys[i].count)
+      continue;
+    n = b.sys[i].count - a.sys[i].count;
+    for(j = m; j > 0 && b.sys[order[j-1]].count - a.sys[order[j-1]].count < n; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+    m++;
+  }
+
+  printf("syscall\t\tcalls/s\tavg us\tp50 us\tp99 us\n");
+  for(k = 0; k < m; k++){
+    i = order[k];
+    n = b.sys[i].count - a.sys[i].count;
+    for(j = 0; j < NLATBUCKET; j++)
+      hist[j] = b.sys[i].hist[j] - a.sys[i].hist[j];
+    label(names[i]);
+    printf("%l\t%l\t<%l\t<%l\n",
+           n * 1000000000L / ns, (b.sys[i].ns - a.sys[i].ns) / n / 1000,
+           percentile(hist, n, 500), percentile(hist, n, 990));
+  }
+
+  printf("\nirq\tdev\t\tirqs/s\tavg us\n");
+  for(i = 0; i < NIRQ; i++){
+    if((n = b.irq[i].count - a.irq[i].count) == 0)
+      continue;
+    printf("%d\t", i);
+    label(irqnames[i]);
+    printf("%l\t%l\n", n * 1000000000L / ns, (b.irq[i].ns - a.irq[i].ns) / n / 1000);
+  }
+
+  printf("\nhart\tticks/s\tidle%%\n");
+  for(i = 0; i < NCPU; i++){
+    if(b.hart[i].ticks == 0 && b.hart[i].idlens == 0)
+      continue;
+    printf("%d\t%l\t%l\n", i, (b.hart[i].ticks - a.hart[i].ticks) * 1000000000L / ns,
+           (b.hart[i].idlens - a.hart[i].idlens) * 100 / ns);
+  }
+  exit(0);
+}
@@ -0,0 +1,81 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Set the scheduling policy and cpu affinity of a process,
+// or run a command with them.
+//
+//   taskset [-f prio | -n] [-c mask] -p pid
+//   taskset [-f prio | -n] [-c mask] cmd [arg...]
+//
+// -f prio: real-time SCHED_FIFO at priority prio (1..99)
+// -n:      ordinary round-robin SCHED_NORMAL
+// -c mask: run only on the cpus in mask, e.g. 0x4 for cpu 2
+// With -p and no other options, print the current settings.
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: taskset [-f prio | -n] [-c mask] {-p pid | cmd [arg...]}\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, pid, policy, prio, cur;
+  uint64 mask;
+
+  pid = -1;
+  policy = -1;
+  prio = 0;
+  mask = 0;
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-f") == 0 && i+1 < argc){
+      policy = SCHED_FIFO;
+      prio = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-n") == 0){
+      policy = SCHED_NORMAL;
+      prio = 0;
+    } else if(strcmp(argv[i], "-c") == 0 && i+1 < argc){
+      mask = atoix(argv[++i]);
+      if(mask == 0)
+        usage();
+    } else if(strcmp(argv[i], "-p") == 0 && i+1 < argc){
+      pid = atoi(argv[++i]);
+    } else {
+      usage();
+    }
+  }
+  if((pid < 0) == (i == argc))
+    usage();
+
+  if(pid < 0)
+    pid = 0;
+  if(policy >= 0 && setsched(pid, policy, prio) < 0){
+    fprintf(2, "taskset: cannot set policy %d prio %d\n", policy, prio);
+    exit(1);
+  }
+  if(mask && setaffinity(pid, mask) == -1){
+    fprintf(2, "taskset: cannot set affinity %p\n", mask);
+    exit(1);
+  }
+
+  if(i == argc){
+    if(policy < 0 && mask == 0){
+      if((cur = setsched(pid, -1, 0)) < 0){
+        fprintf(2, "taskset: no process %d\n", pid);
+        exit(1);
+      }
+      printf("pid %d: policy %s prio %d affinity %p\n", pid,
+             (cur >> 8) == SCHED_FIFO ? "fifo" : "normal", cur & 0xff,
+             setaffinity(pid, 0));
+    }
+    exit(0);
+  }
+
+  exec(argv[i], argv + i);
+  fprintf(2, "taskset: exec %s failed\n", argv[i]);
+  exit(1);
+}
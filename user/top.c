@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/procstat.h"
+#include "kernel/poll.h"
+#include "user/user.h"
+
+// Show each process's cpu use, context switches and memory,
+// busiest first, refreshed every second. Press enter to quit.
+//
+//   top [count]
+//
+// stops by itself after count refreshes, if count is given.
+
+static struct procstat cur[NPROC], prev[NPROC];
+static uint64 busy[NPROC];  // cpu ns since the last refresh
+static int order[NPROC];
+
+static char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+// cpu ns pid had used at the last refresh, or 0 if it is new.
+static uint64
+prevtime(struct procstat *ps, int nprev)
+{
+  for(int i = 0; i < nprev; i++)
+    if(prev[i].pid == ps->pid)
+      return prev[i].utime + prev[i].stime;
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pollfd pfd;
+  struct procstat *ps;
+  uint64 t0, t1, pm;
+  int count = 0, iter, n, nprev = 0, i, j, k;
+  char line[16];
+
+  if(argc > 2){
+    fprintf(2, "usage: top [count]\n");
+    exit(1);
+  }
+  if(argc == 2)
+    count = atoi(argv[1]);
+
+  t0 = nanotime();
+  for(iter = 0; count == 0 || iter < count; iter++){
+    n = procstat(cur, NPROC);
+    t1 = nanotime();
+    if(n < 0){
+      fprintf(2, "top: procstat failed\n");
+      exit(1);
+    }
+
+    for(i = 0; i < n; i++){
+      busy[i] = cur[i].utime + cur[i].stime - prevtime(&cur[i], nprev);
+      // insertion sort, busiest first.
+      for(j = i; j > 0 && busy[order[j-1]] < busy[i]; j--)
+        order[j] = order[j-1];
+      order[j] = i;
+    }
+
+    printf("\033[H\033[J");
+    printf("pid\tppid\tstate\tcpu%%\tuser ms\tsys ms\tvcsw\tivcsw\tfaults\trss KB\tname\n");
+    for(k = 0; k < n; k++){
+      ps = &cur[order[k]];
+      pm = t1 > t0 ? busy[order[k]] * 1000 / (t1 - t0) : 0;
+      printf("%d\t%d\t%s\t%l.%l\t%l\t%l\t%l\t%l\t%l\t%l\t%s\n",
+             ps->pid, ps->ppid,
+             ps->state >= 0 && ps->state < 6 ? states[ps->state] : "???",
+             pm / 10, pm % 10,
+             ps->utime / 1000000, ps->stime / 1000000,
+             ps->nvcsw, ps->nivcsw, ps->nfaults,
+             ps->rss * 4, ps->name);
+    }
+
+    memmove(prev, cur, n * sizeof(cur[0]));
+    nprev = n;
+    t0 = t1;
+
+    // wait a second, or until a line is typed.
+    pfd.fd = 0;
+    pfd.events = POLLIN;
+    if(poll(&pfd, 1, 1000000000) > 0){
+      read(0, line, sizeof(line));
+      break;
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,95 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/poll.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+// Run a command with the kernel event trace on and save every
+// hart's events to a file, for tools/trace2json.py to turn into
+// a Chrome trace.
+//
+//   trace [-m mask] file cmd [arg...]
+//
+// mask is a sum of TRACE_* categories from kernel/trace.h, all
+// of them unless given. Other processes' events are kept too.
+
+#define NBUF 128
+
+static struct traceev buf[NBUF];
+
+// Move recorded events into fd. Returns how many.
+static int
+drain(int fd)
+{
+  int n, total = 0;
+
+  while((n = traceread(buf, NBUF)) > 0){
+    if(write(fd, buf, n * sizeof(buf[0])) != n * sizeof(buf[0])){
+      fprintf(2, "trace: write failed\n");
+      exit(1);
+    }
+    total += n;
+  }
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pollfd pfd;
+  int mask = TRACE_ALL, fd, p[2], pid, nev = 0, lost;
+
+  if(argc > 2 && strcmp(argv[1], "-m") == 0){
+    mask = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 3){
+    fprintf(2, "usage: trace [-m mask] file cmd [arg...]\n");
+    exit(1);
+  }
+
+  if((fd = open(argv[1], O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    fprintf(2, "trace: cannot open %s\n", argv[1]);
+    exit(1);
+  }
+  // the child holds the write end, so it hangs up when cmd exits.
+  if(pipe(p) < 0){
+    fprintf(2, "trace: pipe failed\n");
+    exit(1);
+  }
+  if(mask == 0 || tracectl(mask) < 0){
+    fprintf(2, "trace: bad mask %d\n", mask);
+    exit(1);
+  }
+
+  if((pid = fork()) < 0){
+    fprintf(2, "trace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p[0]);
+    close(fd);
+    exec(argv[2], argv + 2);
+    fprintf(2, "trace: exec %s failed\n", argv[2]);
+    exit(1);
+  }
+  close(p[1]);
+
+  pfd.fd = p[0];
+  pfd.events = POLLIN;
+  for(;;){
+    nev += drain(fd);
+    // a busy hart can fill its ring in a few milliseconds; the
+    // ring keeps the latest events, and tracectl() counts losses.
+    if(poll(&pfd, 1, 5000000) < 0 || (pfd.revents & POLLHUP))
+      break;
+  }
+
+  lost = tracectl(0);
+  nev += drain(fd);
+  wait(0);
+  close(fd);
+  printf("trace: %d events, %d lost, in %s\n", nev, lost, argv[1]);
+  exit(0);
+}
@@ -1,6 +1,9 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/timepage.h"
 #include "user/user.h"
 
 //
@@ -14,6 +17,44 @@ _main()
   exit(0);
 }
 
+// set by printf.c once it buffers output, so that programs
+// that don't print need not link it. -1 means every fd.
+void (*printflush)(int fd);
+
+int
+fork(void)
+{
+  // the child would otherwise write buffered output again.
+  if(printflush)
+    printflush(-1);
+  return _fork();
+}
+
+int
+exit(int status)
+{
+  if(printflush)
+    printflush(-1);
+  _exit(status);
+}
+
+int
+close(int fd)
+{
+  if(printflush)
+    printflush(fd);
+  return _close(fd);
+}
+
+int
+exec(const char *path, char **argv)
+{
+  // the new image starts with empty buffers.
+  if(printflush)
+    printflush(-1);
+  return _exec(path, argv);
+}
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -25,9 +66,29 @@ strcpy(char *s, const char *t)
   return os;
 }
 
+// the string routines below look at a word at a time once
+// their pointers are aligned. a load never crosses into the
+// next word, so never past the page the string ends in.
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+#define HASZERO(v) (((v) - ONES) & ~(v) & HIGHS)
+
 int
 strcmp(const char *p, const char *q)
 {
+  const uint64 *wp, *wq;
+
+  if((((uint64)p ^ (uint64)q) & 7) == 0){
+    for(; (uint64)p & 7; p++, q++)
+      if(*p == 0 || *p != *q)
+        return (uchar)*p - (uchar)*q;
+    wp = (const uint64*)p;
+    wq = (const uint64*)q;
+    while(*wp == *wq && !HASZERO(*wp))
+      wp++, wq++;
+    p = (const char*)wp;
+    q = (const char*)wq;
+  }
   while(*p && *p == *q)
     p++, q++;
   return (uchar)*p - (uchar)*q;
@@ -36,11 +97,17 @@ strcmp(const char *p, const char *q)
 uint
 strlen(const char *s)
 {
-  int n;
+  const char *e;
+  const uint64 *w;
 
-  for(n = 0; s[n]; n++)
+  for(e = s; (uint64)e & 7; e++)
+    if(*e == 0)
+      return e - s;
+  for(w = (const uint64*)e; !HASZERO(*w); w++)
     ;
-  return n;
+  for(e = (const char*)w; *e; e++)
+    ;
+  return e - s;
 }
 
 void*
@@ -106,6 +173,28 @@ atoi(const char *s)
   return n;
 }
 
+// a decimal or 0x-prefixed hex number.
+uint64
+atoix(const char *s)
+{
+  uint64 n = 0;
+
+  if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X')){
+    for(s += 2; *s; s++){
+      if(*s >= '0' && *s <= '9')
+        n = n*16 + *s - '0';
+      else if(*s >= 'a' && *s <= 'f')
+        n = n*16 + *s - 'a' + 10;
+      else if(*s >= 'A' && *s <= 'F')
+        n = n*16 + *s - 'A' + 10;
+      else
+        break;
+    }
+    return n;
+  }
+  return atoi(s);
+}
+
 void*
 memmove(void *vdst, const void *vsrc, int n)
 {
@@ -140,6 +229,29 @@ memcmp(const void *s1, const void *s2, uint n)
   return 0;
 }
 
+void*
+memchr(const void *s, int c, uint n)
+{
+  const uchar *p = s;
+  const uint64 *w;
+  uint64 v, m;
+
+  c = (uchar)c;
+  for(; n > 0 && ((uint64)p & 7); p++, n--)
+    if(*p == c)
+      return (void*)p;
+  m = ONES * c;
+  for(w = (const uint64*)p; n >= 8; w++, n -= 8){
+    v = *w ^ m;
+    if(HASZERO(v))
+      break;
+  }
+  for(p = (const uchar*)w; n > 0; p++, n--)
+    if(*p == c)
+      return (void*)p;
+  return 0;
+}
+
 void *
 memcpy(void *dst, const void *src, uint n)
 {
@@ -180,4 +292,28 @@ poll_kbd(void)
   kbd_struct.value = kbd_event & 0xFFFFFFFF;
 
   return kbd_struct;
-}
\ No newline at end of file
+}
+// cycles this hart has run, everyone's, not just ours.
+// perfread() has ours.
+uint64
+rdcycle(void)
+{
+  return r_cycle();
+}
+
+// instructions this hart has retired, everyone's.
+uint64
+rdinstret(void)
+{
+  return r_instret();
+}
+
+// nanoseconds since boot, like nanotime(), but read from
+// the kernel's time page without a system call.
+uint64
+timenow(void)
+{
+  struct timepage *tp = (struct timepage*)TIMEPAGE;
+
+  return ((r_time() - tp->base) * tp->mult) >> tp->shift;
+}
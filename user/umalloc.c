@@ -2,90 +2,405 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/param.h"
+#include "kernel/riscv.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator.
+//
+// A request of up to SMALLMAX bytes, header included, is rounded
+// up to one of NCLASS size classes and taken from that class's
+// free list, which is refilled by slicing SPANSIZE spans. Small
+// chunks are never split or merged, so malloc() and free() of one
+// are a handful of loads and stores.
+//
+// A larger request is taken first-fit from a list of free chunks,
+// split to size, or else cut from the top of the heap, which grows
+// with sbrk(). Freed large chunks merge with free neighbours and
+// with the top. Memory above "clean" has not been handed out since
+// sbrk() zeroed it, so calloc() need not clear it again.
 
-typedef long Align;
+struct chunk {
+  uint64 prevsize;      // size of the previous chunk, if PREVFREE
+  uint64 size;          // size of this chunk, header included, | flags
+  struct chunk *next;   // free list links, in the payload
+  struct chunk *prev;   //   of a free chunk
+};
+
+#define HDRSZ     16          // header, which keeps payloads 16-aligned
+#define MINCHUNK  32          // room for the free list links
+#define SMALLMAX  2048        // largest small chunk
+#define SPANSIZE  (64*1024)   // slice small chunks from spans this big
+#define MORECORE  (64*1024)   // least to ask sbrk() for
+
+#define INUSE     1           // chunk is allocated
+#define PREVFREE  2           // previous chunk is free, prevsize valid
+#define SMALL     4           // chunk belongs to a size class
+#define FLAGS     (INUSE|PREVFREE|SMALL)
+#define CSIZE(c)  ((c)->size & ~(uint64)FLAGS)
+#define NEXT(c)   ((struct chunk*)((char*)(c) + CSIZE(c)))
 
-union header {
-  struct {
-    union header *ptr;
-    uint size;
-  } s;
-  Align x;
+#define NCLASS 21
+static ushort classsize[NCLASS] = {
+  32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240, 256,
+  384, 512, 768, 1024, 1536, 2048,
 };
 
-typedef union header Header;
+static struct chunk *bins[NCLASS];  // free small chunks, by class
+static char *spanp, *spanend;       // unsliced rest of the current span
 
-static Header base;
-static Header *freep;
+static struct chunk freelist;       // free large chunks
+static char *top, *topend;          // unused memory at the end of the heap
+static char *brk;                   // end of what sbrk() last gave us
+static char *clean;                 // memory from here up is still zero
 
-void
-free(void *ap)
+static struct mallocstat stats;
+
+static int
+sizeclass(uint64 n)
 {
-  if (ap == 0) return; // free is supposed to check the pointer is null!
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
-}
-
-static Header*
-morecore(uint nu)
+  int i;
+
+  if(n <= 256)
+    return n/16 - 2;
+  for(i = 15; classsize[i] < n; i++)
+    ;
+  return i;
+}
+
+static void
+insert(struct chunk *c)
+{
+  if(freelist.next == 0)
+    freelist.next = freelist.prev = &freelist;
+  c->next = freelist.next;
+  c->prev = &freelist;
+  freelist.next->prev = c;
+  freelist.next = c;
+}
+
+static void
+detach(struct chunk *c)
 {
+  c->prev->next = c->next;
+  c->next->prev = c->prev;
+}
+
+// return in-use large chunk c to the free list,
+// merging it with free neighbours.
+static void
+release(struct chunk *c)
+{
+  struct chunk *nx, *pv;
+  uint64 n;
+
+  n = CSIZE(c);
+  nx = NEXT(c);
+  if(c->size & PREVFREE){
+    // a free chunk's own predecessor is never free.
+    pv = (struct chunk*)((char*)c - c->prevsize);
+    detach(pv);
+    n += CSIZE(pv);
+    c = pv;
+  }
+  if((char*)nx == top){
+    top = (char*)c;
+    return;
+  }
+  if((nx->size & INUSE) == 0){
+    detach(nx);
+    n += CSIZE(nx);
+    nx = (struct chunk*)((char*)c + n);
+  }
+  c->size = n;
+  nx->size |= PREVFREE;
+  nx->prevsize = n;
+  insert(c);
+}
+
+// grow the top to at least n bytes.
+static int
+morecore(uint64 n)
+{
+  struct chunk *c;
   char *p;
-  Header *hp;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
+  // the top always keeps room for a header,
+  // to end the heap below it if sbrk() moves.
+  n += HDRSZ;
+  if(n < MORECORE)
+    n = MORECORE;
+  n = PGROUNDUP(n);
+  p = sbrk(n);
   if(p == (char*)-1)
+    return -1;
+  stats.heap += n;
+  if(p == brk && top != 0){
+    brk += n;
+    topend = (char*)((uint64)brk & ~15);
+    return 0;
+  }
+
+  // someone else moved the break. fence off the old
+  // top, and free whatever is left of it.
+  if(top != 0){
+    c = (struct chunk*)(topend - HDRSZ);
+    c->size = HDRSZ | INUSE;
+    c = (struct chunk*)top;
+    if(topend - top >= MINCHUNK + HDRSZ){
+      c->size = (topend - top - HDRSZ) | INUSE;
+      release(c);
+    } else {
+      c->size = (topend - top) | INUSE;
+    }
+  }
+  brk = p + n;
+  top = (char*)(((uint64)p + 15) & ~15);
+  topend = (char*)((uint64)brk & ~15);
+  // the break may have been lowered into a page
+  // that still holds someone's data.
+  clean = (char*)PGROUNDUP((uint64)p);
+  return 0;
+}
+
+// cut a chunk of n bytes from the top of the heap.
+static struct chunk*
+carve(uint64 n)
+{
+  struct chunk *c;
+
+  if(top == 0 || topend - top < n + HDRSZ)
+    if(morecore(n + HDRSZ) < 0)
+      return 0;
+  c = (struct chunk*)top;
+  c->size = n | INUSE;
+  top += n;
+  return c;
+}
+
+// trim in-use large chunk c to n bytes,
+// if what's left is worth freeing.
+static void
+split(struct chunk *c, uint64 n)
+{
+  struct chunk *r;
+
+  if(CSIZE(c) - n < MINCHUNK)
+    return;
+  r = (struct chunk*)((char*)c + n);
+  r->size = (CSIZE(c) - n) | INUSE;
+  c->size = n | (c->size & FLAGS);
+  release(r);
+}
+
+// allocate a large chunk of n bytes. *zero is
+// set to the start of any memory in it that's
+// known to be zero.
+static struct chunk*
+bigalloc(uint64 n, char **zero)
+{
+  struct chunk *c;
+
+  *zero = (char*)-1;
+  if(freelist.next != 0){
+    for(c = freelist.next; c != &freelist; c = c->next){
+      if(CSIZE(c) >= n){
+        detach(c);
+        c->size |= INUSE;
+        NEXT(c)->size &= ~PREVFREE;
+        split(c, n);
+        return c;
+      }
+    }
+  }
+  if((c = carve(n)) == 0)
     return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  if((char*)c + HDRSZ > clean)
+    *zero = (char*)c + HDRSZ;
+  else
+    *zero = clean;
+  if(clean < (char*)c + n)
+    clean = (char*)c + n;
+  return c;
+}
+
+static struct chunk*
+smallalloc(int i)
+{
+  struct chunk *c;
+  char *zero;
+  int j;
+
+  if((c = bins[i]) != 0){
+    bins[i] = c->next;
+    return c;
+  }
+  if(spanend - spanp < classsize[i]){
+    // keep the rest of the old span for the classes it fits.
+    while(spanend - spanp >= MINCHUNK){
+      for(j = NCLASS-1; classsize[j] > spanend - spanp; j--)
+        ;
+      c = (struct chunk*)spanp;
+      c->next = bins[j];
+      bins[j] = c;
+      spanp += classsize[j];
+    }
+    if((c = bigalloc(SPANSIZE, &zero)) == 0)
+      return 0;
+    spanp = (char*)c + HDRSZ;
+    spanend = (char*)c + SPANSIZE;
+  }
+  c = (struct chunk*)spanp;
+  spanp += classsize[i];
+  return c;
+}
+
+static uint64
+chunksize(uint64 nbytes)
+{
+  uint64 n;
+
+  n = (nbytes + HDRSZ + 15) & ~15;
+  if(n < MINCHUNK)
+    n = MINCHUNK;
+  return n;
+}
+
+static void*
+alloc(uint nbytes, char **zero)
+{
+  struct chunk *c;
+  uint64 n;
+  int i;
+
+  n = chunksize(nbytes);
+  if(n <= SMALLMAX){
+    i = sizeclass(n);
+    if((c = smallalloc(i)) == 0)
+      return 0;
+    c->size = classsize[i] | SMALL | INUSE;
+    *zero = (char*)-1;
+    stats.nsmall++;
+  } else if((c = bigalloc(n, zero)) == 0){
+    return 0;
+  }
+  stats.nmalloc++;
+  stats.inuse += CSIZE(c);
+  return (char*)c + HDRSZ;
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  char *zero;
+
+  return alloc(nbytes, &zero);
+}
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
+void
+free(void *ap)
+{
+  struct chunk *c;
+  int i;
+
+  if(ap == 0)
+    return;
+  c = (struct chunk*)((char*)ap - HDRSZ);
+  stats.nfree++;
+  stats.inuse -= CSIZE(c);
+  if(c->size & SMALL){
+    i = sizeclass(CSIZE(c));
+    c->size &= ~INUSE;
+    c->next = bins[i];
+    bins[i] = c;
+  } else {
+    release(c);
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
+}
+
+void*
+calloc(uint nmemb, uint size)
+{
+  uint64 nbytes;
+  char *p, *zero;
+
+  nbytes = (uint64)nmemb * size;
+  if(nbytes > 0xffffffff)
+    return 0;
+  if((p = alloc(nbytes, &zero)) == 0)
+    return 0;
+  if(zero < p + nbytes){
+    stats.nzero += p + nbytes - zero;
+    memset(p, 0, zero - p);
+  } else {
+    memset(p, 0, nbytes);
+  }
+  return p;
+}
+
+// try to resize large chunk c to n bytes where it is.
+static int
+resize(struct chunk *c, uint64 n)
+{
+  struct chunk *nx;
+  uint64 size;
+
+  size = CSIZE(c);
+  if(n > size){
+    nx = NEXT(c);
+    if((char*)nx == top && topend - top < n - size + HDRSZ)
+      morecore(n - size + HDRSZ);
+    // morecore() may have moved the top away,
+    // leaving a free chunk or a fence at nx.
+    if((char*)nx == top && topend - top >= n - size + HDRSZ){
+      top += n - size;
+      if(clean < top)
+        clean = top;
+      c->size += n - size;
+      size = n;
+    } else if((char*)nx != top && (nx->size & INUSE) == 0 && size + CSIZE(nx) >= n){
+      detach(nx);
+      c->size += CSIZE(nx);
+      NEXT(c)->size &= ~PREVFREE;
+    } else {
+      return 0;
+    }
+  }
+  split(c, n);
+  return 1;
+}
+
+void*
+realloc(void *ap, uint nbytes)
+{
+  struct chunk *c;
+  uint64 n, old;
+  void *np;
+
+  if(ap == 0)
+    return malloc(nbytes);
+  c = (struct chunk*)((char*)ap - HDRSZ);
+  n = chunksize(nbytes);
+  old = CSIZE(c);
+  stats.nrealloc++;
+  if(c->size & SMALL){
+    if(n <= old){
+      stats.ninplace++;
+      return ap;
     }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+  } else if(resize(c, n)){
+    stats.inuse += CSIZE(c) - old;
+    stats.ninplace++;
+    return ap;
   }
+
+  if((np = malloc(nbytes)) == 0)
+    return 0;
+  memmove(np, ap, old - HDRSZ < nbytes ? old - HDRSZ : nbytes);
+  free(ap);
+  return np;
+}
+
+void
+mallocstat(struct mallocstat *st)
+{
+  *st = stats;
 }
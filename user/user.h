@@ -1,4 +1,24 @@
 struct stat;
+struct lockstat;
+struct pollfd;
+struct ring;
+struct sqe;
+struct cqe;
+struct procstat;
+struct profsample;
+struct perfcount;
+struct traceev;
+struct sysstat;
+struct mallocstat {
+  uint64 heap;      // bytes from sbrk()
+  uint64 inuse;     // bytes allocated, headers included
+  uint64 nmalloc;   // allocations
+  uint64 nsmall;    //   of them from a size class
+  uint64 nfree;
+  uint64 nrealloc;
+  uint64 ninplace;  // reallocs that didn't move
+  uint64 nzero;     // bytes calloc() knew were zero
+};
 struct input_event{
 	uint16 type;
 	uint16 code;
@@ -28,6 +48,32 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 uint64 gpucmd(int cmd); // raw virtiogpu call
+int setsched(int pid, int policy, int prio);
+uint64 setaffinity(int pid, uint64 mask);
+uint64 nanotime(void);
+int nanosleep(uint64 ns);
+uint64 irqaffinity(int irq, uint64 mask);
+int irqstat(int irq, uint64 *counts);
+int lockstat(struct lockstat *stats, int n);
+int pipe2(int*, int size);
+int clone(void (*fn)(void*), void *arg, void *stack);
+int futex(int *addr, int op, int val);
+int poll(struct pollfd*, int n, uint64 timeout);
+void* ringsetup(int flags);
+int ringenter(int n);
+int procstat(struct procstat*, int n);
+int profctl(int hz);
+int profread(struct profsample*, int n);
+int perfctl(int counter, uint64 event);
+int perfread(struct perfcount*);
+int tracectl(int mask);
+int traceread(struct traceev*, int n);
+int sysstat(struct sysstat*);
+int lseek(int fd, int off, int whence);
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _close(int);
+int _exec(const char*, char**);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -37,14 +83,31 @@ char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
 void printf(const char*, ...);
+void fflush(int);
+extern void (*printflush)(int);
 char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
+void* calloc(uint, uint);
+void* realloc(void*, uint);
+void mallocstat(struct mallocstat*);
 int atoi(const char*);
+uint64 atoix(const char*);
 int memcmp(const void *, const void *, uint);
+void *memchr(const void*, int, uint);
 void *memcpy(void *, const void *, uint);
+uint64 rdcycle(void);
+uint64 rdinstret(void);
+uint64 timenow(void);
+
+// ring.c
+struct ring* ringinit(int flags);
+struct sqe* ringsqe(struct ring*);
+int ringsubmit(struct ring*);
+struct cqe* ringcqe(struct ring*);
+void ringcqseen(struct ring*);
 // less raw virtiogpu calls
 // FB_WIDTH/HEIGHT have kernel counterparts, keep them the same
 #define FB_WIDTH 320
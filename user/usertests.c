@@ -7,6 +7,15 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/sched.h"
+#include "kernel/futex.h"
+#include "kernel/poll.h"
+#include "kernel/ring.h"
+#include "kernel/procstat.h"
+#include "kernel/prof.h"
+#include "kernel/perf.h"
+#include "kernel/trace.h"
+#include "kernel/sysstat.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -786,6 +795,837 @@ pipe1(char *s)
 }
 
 
+// a pipe2() pipe holds as much as asked for without a reader,
+// keeps bytes in order across its ring pages, and refuses
+// sizes it can't provide.
+void
+pipebig(char *s)
+{
+  enum { SZ = 65536 };
+  int fds[2], i, n, total;
+  static char big[SZ];
+
+  if(pipe2(fds, -1) == 0 || pipe2(fds, 16*SZ) == 0){
+    printf("%s: bad pipe2 size succeeded\n", s);
+    exit(1);
+  }
+  if(pipe2(fds, SZ) != 0){
+    printf("%s: pipe2 failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    big[i] = i % 251;
+  // unaligned pieces, so copies straddle ring pages.
+  for(total = 0; total < SZ; total += n){
+    n = SZ - total < 3001 ? SZ - total : 3001;
+    if(write(fds[1], big + total, n) != n){
+      printf("%s: write to pipe failed\n", s);
+      exit(1);
+    }
+  }
+  close(fds[1]);
+  memset(big, 0, SZ);
+  for(total = 0; (n = read(fds[0], big + total, SZ - total < 1000 ? SZ - total : 1000)) > 0; total += n)
+    ;
+  close(fds[0]);
+  if(total != SZ){
+    printf("%s: read %d bytes\n", s, total);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++){
+    if((big[i] & 0xff) != i % 251){
+      printf("%s: wrong byte at %d\n", s, i);
+      exit(1);
+    }
+  }
+}
+
+// poll() wakes for pipe data and times out on time.
+void
+polltest(char *s)
+{
+  struct pollfd pfds[3];
+  int fds[2], pid, xst;
+  uint64 t0;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = fds[1];
+  pfds[1].events = POLLOUT;
+  pfds[2].fd = 99;
+  pfds[2].events = POLLIN;
+  if(poll(pfds, 3, 0) != 2 || pfds[0].revents != 0 ||
+     pfds[1].revents != POLLOUT || pfds[2].revents != POLLNVAL){
+    printf("%s: wrong revents %d %d %d\n", s,
+           pfds[0].revents, pfds[1].revents, pfds[2].revents);
+    exit(1);
+  }
+
+  // an empty pipe times out.
+  t0 = nanotime();
+  if(poll(pfds, 1, 20000000) != 0){
+    printf("%s: poll of empty pipe returned early\n", s);
+    exit(1);
+  }
+  if(nanotime() - t0 < 20000000){
+    printf("%s: poll timed out too soon\n", s);
+    exit(1);
+  }
+
+  // data from another process ends a wait with no timeout.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sleep(2);
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  if(poll(pfds, 1, POLLFOREVER) != 1 || pfds[0].revents != POLLIN){
+    printf("%s: poll missed pipe data\n", s);
+    exit(1);
+  }
+  wait(&xst);
+
+  // so does the last writer going away.
+  close(fds[1]);
+  if(poll(pfds, 1, POLLFOREVER) != 1 || pfds[0].revents != (POLLIN|POLLHUP)){
+    printf("%s: poll missed hangup\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+// a write that lands while poll() is still scanning must still
+// end its wait. no sleep() in the writer, so the two race; a lost
+// wakeup shows up as the one-second timeout expiring.
+void
+pollracetest(char *s)
+{
+  struct pollfd pfd;
+  int fds[2], pid, i, r;
+  char c;
+
+  for(i = 0; i < 200; i++){
+    if(pipe(fds) != 0){
+      printf("%s: pipe failed\n", s);
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      write(fds[1], "x", 1);
+      exit(0);
+    }
+    pfd.fd = fds[0];
+    pfd.events = POLLIN;
+    r = poll(&pfd, 1, 1000000000);
+    if(r != 1 || (pfd.revents & POLLIN) == 0){
+      printf("%s: poll returned %d, revents %d, on round %d\n", s, r, pfd.revents, i);
+      exit(1);
+    }
+    if(read(fds[0], &c, 1) != 1 || c != 'x'){
+      printf("%s: read failed\n", s);
+      exit(1);
+    }
+    wait(0);
+    close(fds[0]);
+    close(fds[1]);
+  }
+}
+
+// find our own procstat entry.
+static int
+myprocstat(struct procstat *me)
+{
+  static struct procstat all[NPROC];
+  int n, pid = getpid();
+
+  n = procstat(all, NPROC);
+  for(int i = 0; i < n; i++){
+    if(all[i].pid == pid){
+      *me = all[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// accounting counts user time, sleeps and memory.
+void
+procstattest(char *s)
+{
+  struct procstat a, b;
+  uint64 t0;
+
+  if(myprocstat(&a) < 0){
+    printf("%s: no procstat entry for us\n", s);
+    exit(1);
+  }
+  t0 = nanotime();
+  while(nanotime() - t0 < 50000000)
+    ;
+  sleep(1);
+  if(myprocstat(&b) < 0){
+    printf("%s: procstat entry went away\n", s);
+    exit(1);
+  }
+  if(b.utime <= a.utime || b.nvcsw <= a.nvcsw){
+    printf("%s: utime or nvcsw did not grow\n", s);
+    exit(1);
+  }
+  if(b.rss == 0 || b.rss > b.sz / PGSIZE || b.tgid != b.pid){
+    printf("%s: rss %l for sz %l\n", s, b.rss, b.sz);
+    exit(1);
+  }
+}
+
+// the profiler samples us while we spin.
+void
+proftest(char *s)
+{
+  static struct profsample ps[64];
+  uint64 t0;
+  int n, i, ours = 0;
+
+  if(profctl(PROFMAXHZ + 1) != -1){
+    printf("%s: profctl accepted too high a rate\n", s);
+    exit(1);
+  }
+  if(profctl(1000) < 0){
+    printf("%s: profctl failed\n", s);
+    exit(1);
+  }
+  t0 = nanotime();
+  while(nanotime() - t0 < 50000000)
+    ;
+  profctl(0);
+  while((n = profread(ps, 64)) > 0){
+    for(i = 0; i < n; i++){
+      if(ps[i].pid == getpid() && ps[i].depth <= PROFDEPTH)
+        ours++;
+    }
+  }
+  if(n < 0 || ours == 0){
+    printf("%s: no samples of us\n", s);
+    exit(1);
+  }
+}
+
+// our own cycle and instruction counts grow as we run, and
+// we may read the hart's counters without a trap.
+void
+perftest(char *s)
+{
+  struct perfcount a, b;
+  volatile int i;
+
+  if(perfctl(NHPM, PERF_INSTRET) != -1){
+    printf("%s: perfctl accepted a counter that isn't there\n", s);
+    exit(1);
+  }
+  if(perfread(&a) < 0){
+    printf("%s: perfread failed\n", s);
+    exit(1);
+  }
+  rdcycle();
+  rdinstret();
+  for(i = 0; i < 1000000; i++)
+    ;
+  perfread(&b);
+  if(b.instret - a.instret < 1000000 || b.cycles <= a.cycles){
+    printf("%s: counted %l instructions for a million loops\n", s, b.instret - a.instret);
+    exit(1);
+  }
+}
+
+// the trace sees our system calls, entry and exit.
+void
+tracetest(char *s)
+{
+  static struct traceev ev[128];
+  int n, i, in = 0, out = 0;
+
+  if(tracectl(TRACE_ALL + 1) != -1){
+    printf("%s: tracectl accepted a bad mask\n", s);
+    exit(1);
+  }
+  if(tracectl(TRACE_SYSCALL) < 0){
+    printf("%s: tracectl failed\n", s);
+    exit(1);
+  }
+  getpid();
+  tracectl(0);
+  while((n = traceread(ev, 128)) > 0){
+    for(i = 0; i < n; i++){
+      if(ev[i].pid != getpid())
+        continue;
+      if(ev[i].type == TR_SYSCALL && ev[i].arg == SYS_getpid)
+        in++;
+      if(ev[i].type == TR_SYSRET && ev[i].arg2 == SYS_getpid && ev[i].arg == getpid())
+        out++;
+    }
+  }
+  if(n < 0 || in == 0 || out == 0){
+    printf("%s: getpid not traced\n", s);
+    exit(1);
+  }
+}
+
+// system calls are counted, and each lands in one histogram bucket.
+void
+sysstattest(char *s)
+{
+  static struct sysstat a, b;
+  uint64 n, t0;
+  int i, ticks = 0;
+
+  if(sysstat(&a) < 0){
+    printf("%s: sysstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++)
+    getpid();
+  // spin for a few ticks; an idle hart doesn't take them.
+  t0 = nanotime();
+  while(nanotime() - t0 < 100000000)
+    ;
+  sysstat(&b);
+  if(b.sys[SYS_getpid].count - a.sys[SYS_getpid].count < 10){
+    printf("%s: getpid not counted\n", s);
+    exit(1);
+  }
+  n = 0;
+  for(i = 0; i < NLATBUCKET; i++)
+    n += b.sys[SYS_getpid].hist[i];
+  if(n != b.sys[SYS_getpid].count){
+    printf("%s: histogram has %l calls of %l\n", s, n, b.sys[SYS_getpid].count);
+    exit(1);
+  }
+  for(i = 0; i < NCPU; i++)
+    ticks += b.hart[i].ticks > a.hart[i].ticks;
+  if(ticks == 0){
+    printf("%s: no clock ticks counted\n", s);
+    exit(1);
+  }
+}
+
+// printf output to a file is buffered until fflush or close,
+// and fork doesn't hand the child a copy of it.
+void
+printbuftest(char *s)
+{
+  char buf[64];
+  struct stat st;
+  int fd, n, pid, xst;
+
+  unlink("printbuf");
+  fd = open("printbuf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  fprintf(fd, "a%d\n", 1);
+  if(fstat(fd, &st) < 0 || st.size != 0){
+    printf("%s: output not buffered\n", s);
+    exit(1);
+  }
+  fflush(fd);
+  if(fstat(fd, &st) < 0 || st.size != 3){
+    printf("%s: fflush wrote %l bytes\n", s, st.size);
+    exit(1);
+  }
+  fprintf(fd, "b%d\n", 2);
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    fprintf(fd, "c%d\n", 3);
+    exit(0);
+  }
+  wait(&xst);
+  fprintf(fd, "d%d\n", 4);
+  close(fd);
+
+  fd = open("printbuf", O_RDONLY);
+  n = read(fd, buf, sizeof(buf)-1);
+  close(fd);
+  unlink("printbuf");
+  if(n < 0)
+    n = 0;
+  buf[n] = 0;
+  if(strcmp(buf, "a1\nb2\nc3\nd4\n") != 0){
+    printf("%s: file holds %s\n", s, buf);
+    exit(1);
+  }
+}
+
+// exec replaces the process's buffers, so it writes out
+// what printf has buffered first.
+void
+execflushtest(char *s)
+{
+  char buf[32], *argv[] = { "echo", "b", 0 };
+  int fd, n, pid, xst;
+
+  unlink("execflush");
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(1);
+    if(open("execflush", O_CREATE|O_WRONLY) != 1){
+      fprintf(2, "%s: open failed\n", s);
+      exit(1);
+    }
+    printf("a%d\n", 1);
+    exec("echo", argv);
+    fprintf(2, "%s: exec failed\n", s);
+    exit(1);
+  }
+  wait(&xst);
+  if(xst != 0)
+    exit(1);
+
+  fd = open("execflush", O_RDONLY);
+  n = read(fd, buf, sizeof(buf)-1);
+  close(fd);
+  unlink("execflush");
+  if(n < 0)
+    n = 0;
+  buf[n] = 0;
+  if(strcmp(buf, "a1\nb\n") != 0){
+    printf("%s: file holds %s\n", s, buf);
+    exit(1);
+  }
+}
+
+// realloc keeps contents and grows in place when it can,
+// and calloc memory is zero even after reuse.
+void
+realloctest(char *s)
+{
+  struct mallocstat a, b;
+  char *p, *q;
+  int i, j;
+
+  for(i = 0; i < 2; i++){
+    p = calloc(100, 1000);
+    if(p == 0){
+      printf("%s: calloc failed\n", s);
+      exit(1);
+    }
+    for(j = 0; j < 100*1000; j++){
+      if(p[j] != 0){
+        printf("%s: calloc memory not zero\n", s);
+        exit(1);
+      }
+    }
+    memset(p, 'x', 100*1000);
+    free(p);
+  }
+
+  mallocstat(&a);
+  p = malloc(5000);
+  memset(p, 'y', 5000);
+  q = realloc(p, 50000);
+  if(q == 0){
+    printf("%s: realloc failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 5000; i++){
+    if(q[i] != 'y'){
+      printf("%s: realloc lost contents\n", s);
+      exit(1);
+    }
+  }
+  p = malloc(40);
+  if(realloc(p, 41) != p){
+    printf("%s: small realloc moved\n", s);
+    exit(1);
+  }
+  free(p);
+  free(q);
+  mallocstat(&b);
+  if(b.ninplace - a.ninplace < 2 || b.nrealloc - a.nrealloc != 2){
+    printf("%s: %l of %l reallocs in place\n", s,
+           b.ninplace - a.ninplace, b.nrealloc - a.nrealloc);
+    exit(1);
+  }
+  if(b.inuse != a.inuse){
+    printf("%s: %l bytes in use, expected %l\n", s, b.inuse, a.inuse);
+    exit(1);
+  }
+}
+
+// lseek moves the offset, but not past the end of the file.
+void
+lseektest(char *s)
+{
+  char c;
+  int fd;
+
+  unlink("lseek");
+  fd = open("lseek", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  write(fd, "abcdef", 6);
+  if(lseek(fd, 2, SEEK_SET) != 2 || read(fd, &c, 1) != 1 || c != 'c'){
+    printf("%s: SEEK_SET failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 1, SEEK_CUR) != 4 || read(fd, &c, 1) != 1 || c != 'e'){
+    printf("%s: SEEK_CUR failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -6, SEEK_END) != 0 || read(fd, &c, 1) != 1 || c != 'a'){
+    printf("%s: SEEK_END failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 7, SEEK_SET) != -1 || lseek(fd, -1, SEEK_SET) != -1){
+    printf("%s: seeked outside the file\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("lseek");
+  if(lseek(0, 0, SEEK_SET) != -1){
+    printf("%s: seeked the console\n", s);
+    exit(1);
+  }
+}
+
+// ulib's word-at-a-time string routines, at every alignment,
+// and with strings that end at a word or the end of memory.
+void
+stringtest(char *s)
+{
+  static char a[64], b[64];
+  char *p, *q, *end;
+  int i, j, k, n;
+
+  for(i = 0; i < 8; i++){
+    for(n = 0; n < 40; n++){
+      memset(a, 'x', sizeof(a));
+      a[i+n] = 0;
+      if(strlen(a+i) != n){
+        printf("%s: strlen at offset %d is %d, not %d\n", s, i, strlen(a+i), n);
+        exit(1);
+      }
+    }
+  }
+
+  // mismatched alignments, and a difference at each place.
+  for(i = 0; i < 8; i++){
+    for(j = 0; j < 8; j++){
+      for(n = 0; n < 24; n++){
+        memset(a, 'x', sizeof(a));
+        memset(b, 'x', sizeof(b));
+        a[i+n] = 0;
+        b[j+n] = 0;
+        if(strcmp(a+i, b+j) != 0){
+          printf("%s: strcmp offsets %d %d len %d not equal\n", s, i, j, n);
+          exit(1);
+        }
+        for(k = 0; k <= n; k++){
+          b[j+k] = (char)0xf0;
+          if(strcmp(a+i, b+j) >= 0 || strcmp(b+j, a+i) <= 0){
+            printf("%s: strcmp offsets %d %d differ at %d\n", s, i, j, k);
+            exit(1);
+          }
+          b[j+k] = k == n ? 0 : 'x';
+        }
+      }
+    }
+  }
+
+  for(i = 0; i < 8; i++){
+    for(n = 0; n < 21; n++){
+      memset(a, 'x', sizeof(a));
+      if(memchr(a+i, 'y', n) != 0){
+        printf("%s: memchr found what isn't there\n", s);
+        exit(1);
+      }
+      for(k = 0; k < n; k++){
+        a[i+k] = (char)0xa5;
+        if(memchr(a+i, 0xa5, n) != a+i+k || memchr(a+i, 0x1a5, n) != a+i+k){
+          printf("%s: memchr offset %d len %d missed %d\n", s, i, n, k);
+          exit(1);
+        }
+        a[i+k] = 'x';
+      }
+      a[i+n] = (char)0xa5;
+      if(memchr(a+i, 0xa5, n) != 0){
+        printf("%s: memchr offset %d looked past %d\n", s, i, n);
+        exit(1);
+      }
+    }
+  }
+
+  // strings whose terminator is the last byte of the heap;
+  // reading a word past it would fault.
+  p = sbrk(PGSIZE);
+  if(p == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  end = (char*)PGROUNDUP((uint64)sbrk(0)) - 1;
+  for(n = 0; n < 16; n++){
+    q = end - n;
+    memset(q, 'z', n);
+    *end = 0;
+    if(strlen(q) != n || strcmp(q, q) != 0 || memchr(q, 0, n+1) != end){
+      printf("%s: string of %d at the end of memory\n", s, n);
+      exit(1);
+    }
+  }
+  sbrk(-PGSIZE);
+}
+
+// Doom's snprintf and strstr, from user/doom/xv6.c.
+int snprintf(char*, uint64, const char*, ...);
+char *strstr(const char*, const char*);
+
+static void
+snprintfcheck(char *s, char *buf, int n, char *want)
+{
+  if(strcmp(buf, want) != 0 || n != strlen(want)){
+    printf("%s: got %s (%d), want %s\n", s, buf, n, want);
+    exit(1);
+  }
+}
+
+void
+snprintftest(char *s)
+{
+  char buf[32], *hay;
+  int n;
+
+  // truncated output still returns the full length.
+  memset(buf, '#', sizeof(buf));
+  n = snprintf(buf, 5, "%s", "hello world");
+  if(n != 11 || strcmp(buf, "hell") != 0 || buf[5] != '#'){
+    printf("%s: truncated to %s, returned %d\n", s, buf, n);
+    exit(1);
+  }
+  buf[0] = '#';
+  if(snprintf(buf, 0, "%d", 12345) != 5 || buf[0] != '#'){
+    printf("%s: wrote to an empty buffer\n", s);
+    exit(1);
+  }
+  if(snprintf(buf, 4, "%05d", -42) != 5 || strcmp(buf, "-00") != 0){
+    printf("%s: truncated number is %s\n", s, buf);
+    exit(1);
+  }
+
+  // formats Doom builds lump names with.
+  snprintfcheck(s, buf, snprintf(buf, sizeof(buf), "STCFN%.3d", 33), "STCFN033");
+  snprintfcheck(s, buf, snprintf(buf, sizeof(buf), "CWILV%2.2d", 5), "CWILV05");
+  snprintfcheck(s, buf, snprintf(buf, sizeof(buf), "CWILV%2.2d", 12), "CWILV12");
+  snprintfcheck(s, buf, snprintf(buf, sizeof(buf), "WIA%d%.2d%.2d", 0, 5, 2), "WIA00502");
+  snprintfcheck(s, buf, snprintf(buf, sizeof(buf), "[%4.2s|%-4d|%#x|%%]", "abc", -7, 31),
+                "[  ab|-7  |0x1f|%]");
+
+  hay = "DEMO1 DEMO DEMO2";
+  if(strstr(hay, "DEMO2") != hay + 11 || strstr(hay, "") != hay ||
+     strstr(hay, "DEMO3") != 0){
+    printf("%s: strstr failed\n", s);
+    exit(1);
+  }
+  // long enough to take the skip table.
+  hay = "E1M1E1M2E1M3E1M4E1M5E1M6E1M7E1M8E1M9E2M1E2M2E2M3E2M4E2M5E2M6E2M7E2M8";
+  if(strstr(hay, "E2M7E2M8") != hay + 60 || strstr(hay, "E2M8E2M9") != 0){
+    printf("%s: long strstr failed\n", s);
+    exit(1);
+  }
+}
+
+// batched system calls through the rings.
+void
+ringtest(char *s)
+{
+  struct ring *r;
+  struct sqe *e;
+  struct cqe *c;
+  int fds[2], i;
+  char out[3];
+
+  if((r = ringinit(0)) == 0){
+    printf("%s: ringinit failed\n", s);
+    exit(1);
+  }
+  if(ringinit(0) != 0){
+    printf("%s: second ringinit succeeded\n", s);
+    exit(1);
+  }
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  e = ringsqe(r);
+  e->op = RING_NOP;
+  e->data = 1;
+  e = ringsqe(r);
+  e->op = RING_WRITE;
+  e->fd = fds[1];
+  e->addr = (uint64)"abc";
+  e->len = 3;
+  e->data = 2;
+  e = ringsqe(r);
+  e->op = RING_READ;
+  e->fd = fds[0];
+  e->addr = (uint64)out;
+  e->len = 3;
+  e->data = 3;
+  e = ringsqe(r);
+  e->op = RING_WRITE;
+  e->fd = 99;
+  e->data = 4;
+  if(ringsubmit(r) != 4){
+    printf("%s: ringsubmit did not take 4\n", s);
+    exit(1);
+  }
+  static uint64 want[] = { 0, 3, 3, -1 };
+  for(i = 0; i < 4; i++){
+    if((c = ringcqe(r)) == 0 || c->data != i+1 || c->res != want[i]){
+      printf("%s: bad completion %d\n", s, i);
+      exit(1);
+    }
+    ringcqseen(r);
+  }
+  if(ringcqe(r) != 0 || memcmp(out, "abc", 3) != 0){
+    printf("%s: wrong ring results\n", s);
+    exit(1);
+  }
+
+  // the completion ring never overflows: the kernel stops.
+  for(i = 0; i < NRING; i++)
+    ringsqe(r)->op = RING_NOP;
+  ringsubmit(r);
+  for(i = 0; i < NRING; i++)
+    ringsqe(r)->op = RING_NOP;
+  if(ringsubmit(r) != 0){
+    printf("%s: overflowed the completion ring\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// a futex mutex for threadtest: 0 is unlocked, 1 locked,
+// and 2 locked with threads asleep waiting for it.
+static int tlock, tcount;
+static char tstacks[4][PGSIZE] __attribute__((aligned(16)));
+
+static void
+tacquire(int *l)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(l, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = __sync_lock_test_and_set(l, 2);
+  while(c != 0){
+    futex(l, FUTEX_WAIT, 2);
+    c = __sync_lock_test_and_set(l, 2);
+  }
+}
+
+static void
+trelease(int *l)
+{
+  if(__sync_fetch_and_sub(l, 1) != 1){
+    __sync_lock_release(l);
+    futex(l, FUTEX_WAKE, 1);
+  }
+}
+
+static void
+tcounter(void *arg)
+{
+  for(int i = 0; i < 1000; i++){
+    tacquire(&tlock);
+    tcount++;
+    trelease(&tlock);
+  }
+  exit((int)(uint64)arg);
+}
+
+static void
+tspin(void *arg)
+{
+  for(;;)
+    ;
+}
+
+// threads share memory, and their mutex doesn't lose counts.
+void
+threadtest(char *s)
+{
+  int tids[4], i, j, pid, xst;
+
+  if(futex(&tlock, FUTEX_WAIT, 1) != -1){
+    printf("%s: futex slept on a changed value\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4; i++){
+    if((tids[i] = clone(tcounter, (void*)(uint64)(i+10), tstacks[i] + PGSIZE)) < 0){
+      printf("%s: clone failed\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < 4; i++){
+    if((pid = wait(&xst)) < 0){
+      printf("%s: wait failed\n", s);
+      exit(1);
+    }
+    for(j = 0; j < 4 && tids[j] != pid; j++)
+      ;
+    if(j == 4 || xst != j+10){
+      printf("%s: wait returned %d status %d\n", s, pid, xst);
+      exit(1);
+    }
+  }
+  if(tcount != 4000){
+    printf("%s: count %d, not 4000\n", s, tcount);
+    exit(1);
+  }
+
+  // a process that exits takes its threads with it.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(clone(tspin, 0, tstacks[0] + PGSIZE) < 0)
+      exit(1);
+    if(exec("echo", (char*[]){"echo", 0}) != -1)
+      exit(1);
+    exit(0);
+  }
+  wait(&xst);
+  if(xst != 0){
+    printf("%s: threaded child failed\n", s);
+    exit(1);
+  }
+}
+
 // test if child is killed (status = -1)
 void
 killstatus(char *s)
@@ -2571,6 +3411,182 @@ badarg(char *s)
   exit(0);
 }
 
+// nanosleep() should sleep at least as long as asked, but not
+// a whole clock tick longer, and nanotime() should never go back.
+void
+nanosleeptest(char *s)
+{
+  uint64 t0, t1, prev;
+  uint64 ns = 2000000; // 2ms, well under one clock tick.
+
+  for(int i = 0; i < 10; i++){
+    t0 = nanotime();
+    if(nanosleep(ns) < 0){
+      printf("%s: nanosleep failed\n", s);
+      exit(1);
+    }
+    t1 = nanotime();
+    if(t1 - t0 < ns){
+      printf("%s: slept %d ns, asked for %d\n", s, (int)(t1 - t0), (int)ns);
+      exit(1);
+    }
+    // the timer fires between ticks; it should not
+    // wait for the next one.
+    if(t1 - t0 > ns + TICKNS/2){
+      printf("%s: slept %d ns, asked for %d\n", s, (int)(t1 - t0), (int)ns);
+      exit(1);
+    }
+  }
+
+  prev = nanotime();
+  for(int i = 0; i < 10000; i++){
+    t0 = nanotime();
+    if(t0 < prev){
+      printf("%s: nanotime went backwards\n", s);
+      exit(1);
+    }
+    prev = t0;
+  }
+}
+
+// timenow() reads the time page without a system call; it
+// should agree with nanotime(), and the page should be read-only.
+void
+timepagetest(char *s)
+{
+  uint64 a, b, c;
+  int pid, xstatus;
+
+  for(int i = 0; i < 1000; i++){
+    a = nanotime();
+    b = timenow();
+    c = nanotime();
+    if(b < a || b > c){
+      printf("%s: timenow() disagrees with nanotime()\n", s);
+      exit(1);
+    }
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    *(volatile uint64*)TIMEPAGE = 0;
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: wrote the time page\n", s);
+    exit(1);
+  }
+}
+
+// a process woken on another, idle, cpu should run right away,
+// because wakeup() interrupts that cpu, rather than at some
+// later clock tick.
+void
+wakelatency(char *s)
+{
+  int ping[2], pong[2], pid, xstatus;
+  uint64 t0, t1;
+  char c;
+  int n = 100;
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(ping[1]);
+    close(pong[0]);
+    // only one cpu? nothing to test.
+    if(setaffinity(0, 2) == -1)
+      exit(0);
+    for(int i = 0; i < n; i++){
+      if(read(ping[0], &c, 1) != 1)
+        exit(1);
+      if(write(pong[1], &c, 1) != 1)
+        exit(1);
+    }
+    exit(0);
+  }
+  close(ping[0]);
+  close(pong[1]);
+  setaffinity(0, 1);
+  sleep(1); // let the child settle on its cpu.
+  t0 = nanotime();
+  for(int i = 0; i < n; i++){
+    if(write(ping[1], "x", 1) != 1 || read(pong[0], &c, 1) != 1)
+      break;
+  }
+  t1 = nanotime();
+  setaffinity(0, ~0UL);
+  close(ping[1]);
+  close(pong[0]);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child failed\n", s);
+    exit(1);
+  }
+  // a round trip per clock tick (30ms) would take 3 seconds.
+  if(t1 - t0 > n * 5000000L){
+    printf("%s: %d round trips took %d ms\n", s, n, (int)((t1 - t0) / 1000000));
+    exit(1);
+  }
+}
+
+// route the disk's interrupts to hart 0 alone, and check that
+// only hart 0 takes them.
+void
+irqroute(char *s)
+{
+  uint64 before[NCPU], after[NCPU], old;
+  char buf[BSIZE];
+  int fd;
+
+  if(irqaffinity(0, 1) != -1 || irqaffinity(VIRTIO0_IRQ, 0x100L << NCPU) != -1){
+    printf("%s: bad irqaffinity() succeeded\n", s);
+    exit(1);
+  }
+  old = irqaffinity(VIRTIO0_IRQ, 1);
+  if(old == -1){
+    printf("%s: irqaffinity failed\n", s);
+    exit(1);
+  }
+  irqstat(VIRTIO0_IRQ, before);
+
+  memset(buf, 'i', sizeof(buf));
+  fd = open("irqroute", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < 10; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+  unlink("irqroute");
+
+  irqstat(VIRTIO0_IRQ, after);
+  irqaffinity(VIRTIO0_IRQ, old);
+  if(after[0] == before[0]){
+    printf("%s: hart 0 took no disk interrupts\n", s);
+    exit(1);
+  }
+  for(int i = 1; i < NCPU; i++){
+    if(after[i] != before[i]){
+      printf("%s: hart %d took disk interrupts\n", s, i);
+      exit(1);
+    }
+  }
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2594,6 +3610,22 @@ struct test {
   {dirtest, "dirtest"},
   {exectest, "exectest"},
   {pipe1, "pipe1"},
+  {pipebig, "pipebig"},
+  {threadtest, "threads"},
+  {polltest, "poll"},
+  {pollracetest, "pollrace"},
+  {ringtest, "ring"},
+  {procstattest, "procstat"},
+  {proftest, "prof"},
+  {perftest, "perf"},
+  {tracetest, "trace"},
+  {sysstattest, "sysstat"},
+  {printbuftest, "printbuf"},
+  {execflushtest, "execflush"},
+  {realloctest, "realloc"},
+  {lseektest, "lseek"},
+  {stringtest, "string"},
+  {snprintftest, "snprintf"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
   {exitwait, "exitwait"},
@@ -2635,6 +3667,10 @@ struct test {
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
   {badarg, "badarg" },
+  {nanosleeptest, "nanosleep"},
+  {timepagetest, "timepage"},
+  {wakelatency, "wakelatency"},
+  {irqroute, "irqroute"},
 
   { 0, 0},
 };
@@ -2924,6 +3960,82 @@ outofinodes(char *s)
   }
 }
 
+#define NFRAME   100
+#define FRAMENS  (1000000000/35)  // Doom's frame deadline, at 35 tics a second
+
+// spin through NFRAME "frames" of work loop iterations each,
+// and return the 99th percentile frame time in ns.
+static int
+framep99(int work)
+{
+  static uint64 ns[NFRAME];
+  volatile int j;
+  uint64 t0, t1, x;
+  int i, k;
+
+  t0 = nanotime();
+  for(i = 0; i < NFRAME; i++){
+    for(j = 0; j < work; j++)
+      ;
+    t1 = nanotime();
+    ns[i] = t1 - t0;
+    t0 = t1;
+  }
+  for(i = 1; i < NFRAME; i++){
+    x = ns[i];
+    for(k = i; k > 0 && ns[k-1] > x; k--)
+      ns[k] = ns[k-1];
+    ns[k] = x;
+  }
+  return ns[NFRAME*99/100];
+}
+
+// a SCHED_FIFO process, like doom with taskset -f, should meet
+// its frame deadline while ordinary processes saturate every cpu.
+void
+rtsched(char *s)
+{
+  int i, work, base, loaded, rt;
+  int pids[NCPU];
+
+  // size a frame to about half the deadline.
+  for(work = 1 << 12; framep99(work) < FRAMENS/2; work *= 2)
+    ;
+  work = work * 3 / 4;
+  base = framep99(work);
+
+  for(i = 0; i < NCPU; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0)
+      for(;;)
+        ;
+  }
+
+  loaded = framep99(work);
+  if(setsched(0, SCHED_FIFO, 50) < 0){
+    printf("%s: setsched failed\n", s);
+    exit(1);
+  }
+  rt = framep99(work);
+  setsched(0, SCHED_NORMAL, 0);
+
+  for(i = 0; i < NCPU; i++)
+    kill(pids[i]);
+  for(i = 0; i < NCPU; i++)
+    wait(0);
+
+  printf("p99 frame %dus alone, %dus loaded, %dus loaded with SCHED_FIFO: ",
+         base / 1000, loaded / 1000, rt / 1000);
+  if(rt > FRAMENS){
+    printf("%s: p99 frame %dus misses the %dus deadline\n", s, rt / 1000, FRAMENS / 1000);
+    exit(1);
+  }
+}
+
 struct test slowtests[] = {
   {bigdir, "bigdir"},
   {manywrites, "manywrites"},
@@ -2931,6 +4043,7 @@ struct test slowtests[] = {
   {execout, "execout"},
   {diskfull, "diskfull"},
   {outofinodes, "outofinodes"},
+  {rtsched, "rtsched"},
     
   { 0, 0},
 };
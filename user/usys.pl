@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry(name[, stub]): stub names the generated function when
+# ulib.c wraps the system call in C; it defaults to name.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $stub = shift // $name;
+    print ".global $stub\n";
+    print "${stub}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
-entry("close");
+entry("close", "_close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -37,4 +40,26 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("gpucmd");
-entry("kbdcmd");
\ No newline at end of file
+entry("kbdcmd");
+entry("setsched");
+entry("setaffinity");
+entry("nanotime");
+entry("nanosleep");
+entry("irqaffinity");
+entry("irqstat");
+entry("lockstat");
+entry("pipe2");
+entry("clone");
+entry("futex");
+entry("poll");
+entry("ringsetup");
+entry("ringenter");
+entry("procstat");
+entry("profctl");
+entry("profread");
+entry("perfctl");
+entry("perfread");
+entry("tracectl");
+entry("traceread");
+entry("sysstat");
+entry("lseek");
\ No newline at end of file